@@ -0,0 +1,195 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "asmith/lua/event.hpp"
+#include <stdexcept>
+
+namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+		ASMITH_LUA_INLINE size_t roundCapacity(size_t aCapacity) {
+			size_t capacity = 1;
+			while(capacity < aCapacity) capacity <<= 1;
+			return capacity;
+		}
+	}
+
+	// EventQueue
+
+	ASMITH_LUA_INLINE EventQueue::EventQueue(size_t aCapacity) :
+		mEvents(implementation::roundCapacity(aCapacity)),
+		mMask(mEvents.size() - 1)
+	{}
+
+	ASMITH_LUA_INLINE EventQueue::~EventQueue() {
+
+	}
+
+	ASMITH_LUA_INLINE bool EventQueue::push(const Event& aEvent) {
+		const size_t tail = mTail.value.load(std::memory_order_relaxed);
+		if(tail - mHead.value.load(std::memory_order_acquire) == mEvents.size()) return false;
+		mEvents[tail & mMask] = aEvent;
+		mTail.value.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	ASMITH_LUA_INLINE bool EventQueue::pop(Event& aEvent) {
+		const size_t head = mHead.value.load(std::memory_order_relaxed);
+		if(head == mTail.value.load(std::memory_order_acquire)) return false;
+		aEvent = mEvents[head & mMask];
+		mHead.value.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	ASMITH_LUA_INLINE size_t EventQueue::size() const {
+		return mTail.value.load(std::memory_order_acquire) - mHead.value.load(std::memory_order_acquire);
+	}
+
+	ASMITH_LUA_INLINE size_t EventQueue::capacity() const {
+		return mEvents.size();
+	}
+
+	// EventDispatcher
+
+	ASMITH_LUA_INLINE EventDispatcher::EventDispatcher(State& aState, size_t aCapacity, String aRegisterName) :
+		mState(aState),
+		mQueue(aCapacity),
+		mRegisterName(aRegisterName),
+		mErrorCount(0),
+		mPending(0),
+		mHandlers(LUA_NOREF)
+	{
+		lua_State* const state = mState.getHandle();
+		lua_newtable(state);
+		lua_pushvalue(state, -1);
+		mHandlers = luaL_ref(state, LUA_REGISTRYINDEX);
+		lua_pushcclosure(state, registerHandler, 1);
+		lua_setglobal(state, aRegisterName);
+	}
+
+	ASMITH_LUA_INLINE EventDispatcher::~EventDispatcher() {
+		lua_State* const state = mState.getHandle();
+
+		// Lua must not be able to call the register function after its handler table is released
+		lua_getglobal(state, mRegisterName.c_str());
+		if(lua_tocfunction(state, -1) == registerHandler && lua_getupvalue(state, -1, 1)) {
+			lua_rawgeti(state, LUA_REGISTRYINDEX, mHandlers);
+			const bool owned = lua_rawequal(state, -1, -2) != 0;
+			lua_pop(state, 2);
+			if(owned) {
+				lua_pushnil(state);
+				lua_setglobal(state, mRegisterName.c_str());
+			}
+		}
+		lua_pop(state, 1);
+
+		luaL_unref(state, LUA_REGISTRYINDEX, mHandlers);
+	}
+
+	ASMITH_LUA_INLINE int EventDispatcher::registerHandler(lua_State* aState) {
+		const lua_Integer id = luaL_checkinteger(aState, 1);
+		if(id < 0 || id > MAX_ID) return luaL_error(aState, "asmith::Lua::EventDispatcher : Invalid event ID");
+		if(! lua_isnil(aState, 2)) luaL_checktype(aState, 2, LUA_TFUNCTION);
+		lua_settop(aState, 2);
+		lua_rawseti(aState, lua_upvalueindex(1), static_cast<int>(id) + 1);
+		return 0;
+	}
+
+	ASMITH_LUA_INLINE int EventDispatcher::drain(lua_State* aState) {
+		EventDispatcher& self = *static_cast<EventDispatcher*>(lua_touserdata(aState, 1));
+		lua_rawgeti(aState, LUA_REGISTRYINDEX, self.mHandlers);
+		const int handlers = lua_gettop(aState);
+
+		Event event;
+		while(self.mPending > 0 && self.mQueue.pop(event)) {
+			--self.mPending;
+			lua_rawgeti(aState, handlers, static_cast<int>(event.id) + 1);
+			if(! lua_isfunction(aState, -1)) {
+				lua_pop(aState, 1);
+				continue;
+			}
+			lua_pushinteger(aState, static_cast<lua_Integer>(event.id));
+			lua_pushnumber(aState, event.value);
+			if(lua_pcall(aState, 2, 0, 0) != 0) {
+				++self.mErrorCount;
+				const char* const errorMsg = lua_tostring(aState, -1);
+				self.mLastError = errorMsg ? errorMsg : "Unknown error";
+				lua_pop(aState, 1);
+			}
+		}
+		return 0;
+	}
+
+	ASMITH_LUA_INLINE void EventDispatcher::setHandler(uint32_t aID, String aName) {
+		if(aID > MAX_ID) ASMITH_LUA_THROW("asmith::Lua::EventDispatcher::setHandler : Invalid event ID");
+		lua_State* const state = mState.getHandle();
+		lua_rawgeti(state, LUA_REGISTRYINDEX, mHandlers);
+		lua_getglobal(state, aName);
+		if(! lua_isfunction(state, -1)) {
+			lua_pop(state, 2);
+			ASMITH_LUA_THROW(std::string("asmith::Lua::EventDispatcher::setHandler : ") + aName + " is not a function");
+		}
+		lua_rawseti(state, -2, static_cast<int>(aID) + 1);
+		lua_pop(state, 1);
+	}
+
+	ASMITH_LUA_INLINE void EventDispatcher::removeHandler(uint32_t aID) {
+		// No handler can be set for a larger ID
+		if(aID > MAX_ID) return;
+		lua_State* const state = mState.getHandle();
+		lua_rawgeti(state, LUA_REGISTRYINDEX, mHandlers);
+		lua_pushnil(state);
+		lua_rawseti(state, -2, static_cast<int>(aID) + 1);
+		lua_pop(state, 1);
+	}
+
+	ASMITH_LUA_INLINE bool EventDispatcher::post(uint32_t aID, Number aValue) {
+		if(aID > MAX_ID) return false;
+		Event event;
+		event.id = aID;
+		event.value = aValue;
+		return mQueue.push(event);
+	}
+
+	ASMITH_LUA_INLINE size_t EventDispatcher::dispatch() {
+		// Events posted by handlers during the batch are left for the next call
+		const size_t count = mQueue.size();
+		if(count == 0) return 0;
+		mPending = count;
+
+		lua_State* const state = mState.getHandle();
+		lua_pushcfunction(state, drain);
+		lua_pushlightuserdata(state, this);
+		if(lua_pcall(state, 1, 0, 0) != 0) {
+			const std::string errorMsg = lua_tostring(state, -1);
+			lua_pop(state, 1);
+			ASMITH_LUA_THROW("asmith::Lua::EventDispatcher::dispatch : " + errorMsg);
+		}
+		return count - mPending;
+	}
+
+	ASMITH_LUA_INLINE size_t EventDispatcher::getErrorCount() const {
+		return mErrorCount;
+	}
+
+	ASMITH_LUA_INLINE const std::string& EventDispatcher::getLastError() const {
+		return mLastError;
+	}
+
+	ASMITH_LUA_INLINE void EventDispatcher::clearErrors() {
+		mErrorCount = 0;
+		mLastError.clear();
+	}
+
+}}
@@ -0,0 +1,120 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#ifndef ASMITH_LUA_EVENT_HPP
+#define ASMITH_LUA_EVENT_HPP
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "state.hpp"
+
+namespace asmith { namespace Lua {
+
+	struct Event {
+		uint32_t id;
+		Number value;
+	};
+
+	// Fixed size ring buffer, safe for one producer thread and one consumer thread
+	class EventQueue {
+	private:
+		std::vector<Event> mEvents;
+		const size_t mMask;
+		enum { CACHE_LINE = 64 };
+
+		// The consumer writes mHead and the producer writes mTail, so each is padded onto its own cache line.
+		// Padding rather than alignas keeps the queue at the default alignment, which plain new supports before C++17.
+		struct PaddedIndex {
+			char before[CACHE_LINE];
+			std::atomic<size_t> value;
+			char after[CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+			PaddedIndex() : value(0) {}
+		};
+
+		PaddedIndex mHead;
+		PaddedIndex mTail;
+
+		EventQueue(const EventQueue&) = delete;
+		EventQueue(EventQueue&&) = delete;
+		EventQueue& operator=(const EventQueue&) = delete;
+		EventQueue& operator=(EventQueue&&) = delete;
+	public:
+		// The capacity is rounded up to a power of two
+		EventQueue(size_t aCapacity);
+		~EventQueue();
+
+		// Returns false if the queue is full
+		bool push(const Event&);
+		// Returns false if the queue is empty
+		bool pop(Event&);
+		size_t size() const;
+		size_t capacity() const;
+	};
+
+	// Dispatches queued events to Lua handlers registered by integer ID.
+	// Handlers are kept in a table pinned in the registry and indexed by ID, so dispatch does no global lookups,
+	// and a whole batch of events is delivered in one protected call with each handler isolated by its own pcall.
+	// Lua registers handlers with the global function named by aRegisterName : setEventHandler(id, function)
+	class EventDispatcher {
+	public:
+		enum : uint32_t {
+			// Handlers are stored at ID + 1 and lua_rawseti takes an int index before Lua 5.3
+			MAX_ID = INT_MAX - 1
+		};
+	private:
+		State& mState;
+		EventQueue mQueue;
+		std::string mRegisterName;
+		std::string mLastError;
+		size_t mErrorCount;
+		size_t mPending;
+		int mHandlers;
+
+		static int registerHandler(lua_State*);
+		static int drain(lua_State*);
+
+		EventDispatcher(const EventDispatcher&) = delete;
+		EventDispatcher(EventDispatcher&&) = delete;
+		EventDispatcher& operator=(const EventDispatcher&) = delete;
+		EventDispatcher& operator=(EventDispatcher&&) = delete;
+	public:
+		EventDispatcher(State&, size_t aCapacity = 4096, String aRegisterName = "setEventHandler");
+		// Sets the register function's global to nil, unless it has been replaced since
+		~EventDispatcher();
+
+		// Sets the handler for aID to the global function aName, throws if aID is greater than MAX_ID
+		void setHandler(uint32_t aID, String aName);
+		void removeHandler(uint32_t aID);
+
+		// Queues an event, returns false if the queue is full or aID is greater than MAX_ID
+		bool post(uint32_t aID, Number aValue = 0.0);
+
+		// Delivers every event queued before the call and returns how many were taken from the queue.
+		// Events without a handler are dropped, errors raised by handlers are counted and do not stop the batch.
+		size_t dispatch();
+
+		size_t getErrorCount() const;
+		const std::string& getLastError() const;
+		void clearErrors();
+	};
+}}
+
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "event.cpp"
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "asmith/lua/module.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <stdexcept>
+
+namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+		typedef std::shared_ptr<const std::string> Chunk;
+
+		ASMITH_LUA_INLINE std::mutex& moduleMutex() {
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		ASMITH_LUA_INLINE std::map<std::string, Chunk>& moduleChunks() {
+			static std::map<std::string, Chunk> chunks;
+			return chunks;
+		}
+
+		struct ModuleCounters {
+			std::atomic<uint64_t> hits;
+			std::atomic<uint64_t> misses;
+			std::atomic<uint64_t> loadTime;
+		};
+
+		ASMITH_LUA_INLINE ModuleCounters& moduleCounters() {
+			static ModuleCounters counters = { { 0 }, { 0 }, { 0 } };
+			return counters;
+		}
+
+		ASMITH_LUA_INLINE Chunk findModule(const char* aName) {
+			std::lock_guard<std::mutex> lock(moduleMutex());
+			const auto i = moduleChunks().find(aName);
+			return i == moduleChunks().end() ? Chunk() : i->second;
+		}
+
+		ASMITH_LUA_INLINE int dumpWriter(lua_State*, const void* aData, size_t aSize, void* aUser) {
+			static_cast<std::string*>(aUser)->append(static_cast<const char*>(aData), aSize);
+			return 0;
+		}
+
+		// Loads a chunk into a scratch state, throwing with the Lua error if it does not load.
+		// Precompiled chunks are checked by the same load, which rejects bytecode from another Lua version or a corrupt dump.
+		// Returns the bytecode of the loaded function when aDump is set.
+		ASMITH_LUA_INLINE std::string loadModule(const char* aFunction, String aName, const char* aChunk, size_t aSize, bool aDump) {
+			const std::string chunkName = std::string("=") + aName;
+			lua_State* const state = luaL_newstate();
+			if(! state) ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::") + aFunction + " : Failed to create Lua state");
+
+			if(luaL_loadbuffer(state, aChunk, aSize, chunkName.c_str()) != 0) {
+				const std::string errorMsg = lua_tostring(state, -1);
+				lua_close(state);
+				ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::") + aFunction + " : " + errorMsg);
+			}
+
+			std::string bytecode;
+			if(aDump) {
+#if LUA_VERSION_NUM >= 503
+				lua_dump(state, dumpWriter, &bytecode, 0);
+#else
+				lua_dump(state, dumpWriter, &bytecode);
+#endif
+			}
+			lua_close(state);
+			return bytecode;
+		}
+
+		// Identifies the Lua build that wrote an archive : a magic string, LUA_VERSION_NUM, the LuaJIT version if any
+		// and the dump of an empty chunk, whose header records the bytecode format, type sizes and byte order
+		ASMITH_LUA_INLINE std::string archiveHeader(const char* aFunction) {
+			std::string header("ASMLUAM1", 8);
+			const uint32_t version = LUA_VERSION_NUM;
+			header.append(reinterpret_cast<const char*>(&version), sizeof(version));
+#ifdef LUAJIT_VERSION
+			header += LUAJIT_VERSION;
+#endif
+			header.push_back('\0');
+			return header + loadModule(aFunction, "", "", 0, true);
+		}
+
+		ASMITH_LUA_INLINE int moduleSearcher(lua_State* aState) {
+			const char* const name = luaL_checkstring(aState, 1);
+			bool found = false;
+			int error = 0;
+			{
+				const Chunk chunk = findModule(name);
+				if(chunk) {
+					found = true;
+					const std::string chunkName = std::string("=") + name;
+					const auto begin = std::chrono::steady_clock::now();
+					error = luaL_loadbuffer(aState, chunk->data(), chunk->size(), chunkName.c_str());
+					const auto end = std::chrono::steady_clock::now();
+					moduleCounters().loadTime += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+				}
+			}
+			// Raised after the scope above so no destructors are skipped by lua_error
+
+			if(! found) {
+				++moduleCounters().misses;
+				lua_pushfstring(aState, "\n\tno module '%s' in asmith::Lua::ModuleCache", name);
+				return 1;
+			}
+			if(error) return lua_error(aState);
+
+			++moduleCounters().hits;
+			lua_pushvalue(aState, 1);
+			return 2;
+		}
+
+		ASMITH_LUA_INLINE uint32_t readLength(std::istream& aStream) {
+			uint32_t length = 0;
+			aStream.read(reinterpret_cast<char*>(&length), sizeof(length));
+			return length;
+		}
+
+		ASMITH_LUA_INLINE void writeLength(std::ostream& aStream, size_t aLength) {
+			if(aLength > UINT32_MAX) ASMITH_LUA_THROW("asmith::Lua::ModuleCache::saveArchive : Record is too large");
+			const uint32_t length = static_cast<uint32_t>(aLength);
+			aStream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		}
+	}
+
+	// ModuleCache
+
+	ASMITH_LUA_INLINE void ModuleCache::add(String aName, const char* aChunk, size_t aSize) {
+		// Precompiled chunks are stored unchanged once they have been checked to load
+		const bool precompiled = aSize > 0 && aChunk[0] == LUA_SIGNATURE[0];
+		const std::string bytecode = implementation::loadModule("add", aName, aChunk, aSize, ! precompiled);
+		implementation::Chunk chunk = std::make_shared<const std::string>(
+			precompiled ? std::string(aChunk, aSize) : bytecode
+		);
+
+		std::lock_guard<std::mutex> lock(implementation::moduleMutex());
+		implementation::moduleChunks()[aName].swap(chunk);
+	}
+
+	ASMITH_LUA_INLINE bool ModuleCache::contains(String aName) {
+		return implementation::findModule(aName) != nullptr;
+	}
+
+	ASMITH_LUA_INLINE void ModuleCache::clear() {
+		std::lock_guard<std::mutex> lock(implementation::moduleMutex());
+		implementation::moduleChunks().clear();
+	}
+
+	ASMITH_LUA_INLINE void ModuleCache::loadArchive(const char* aPath) {
+		std::ifstream file(aPath, std::ios::binary);
+		if(! file) ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::loadArchive : Failed to open ") + aPath);
+
+		const std::string expected = implementation::archiveHeader("loadArchive");
+		std::string header(expected.size(), '\0');
+		file.read(&header[0], header.size());
+		if(! file || header != expected) {
+			ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::loadArchive : Archive was not written by this Lua build : ") + aPath);
+		}
+
+		std::string name;
+		std::string chunk;
+		while(file.peek() != std::ifstream::traits_type::eof()) {
+			name.resize(implementation::readLength(file));
+			file.read(&name[0], name.size());
+			chunk.resize(implementation::readLength(file));
+			file.read(&chunk[0], chunk.size());
+			if(! file) ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::loadArchive : Archive is truncated : ") + aPath);
+			add(name.c_str(), chunk.data(), chunk.size());
+		}
+	}
+
+	ASMITH_LUA_INLINE void ModuleCache::saveArchive(const char* aPath) {
+		std::map<std::string, implementation::Chunk> chunks;
+		{
+			std::lock_guard<std::mutex> lock(implementation::moduleMutex());
+			chunks = implementation::moduleChunks();
+		}
+
+		std::ofstream file(aPath, std::ios::binary);
+		if(! file) ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::saveArchive : Failed to open ") + aPath);
+		const std::string header = implementation::archiveHeader("saveArchive");
+		file.write(header.data(), header.size());
+		for(const auto& i : chunks) {
+			implementation::writeLength(file, i.first.size());
+			file.write(i.first.data(), i.first.size());
+			implementation::writeLength(file, i.second->size());
+			file.write(i.second->data(), i.second->size());
+		}
+		if(! file) ASMITH_LUA_THROW(std::string("asmith::Lua::ModuleCache::saveArchive : Failed to write ") + aPath);
+	}
+
+	ASMITH_LUA_INLINE void ModuleCache::install(State& aState) {
+		lua_State* const state = aState.getHandle();
+		const int top = lua_gettop(state);
+
+		lua_getglobal(state, "package");
+		if(! lua_istable(state, -1)) {
+			lua_settop(state, top);
+			ASMITH_LUA_THROW("asmith::Lua::ModuleCache::install : Package library is not loaded");
+		}
+#if LUA_VERSION_NUM >= 502
+		lua_getfield(state, -1, "searchers");
+#else
+		lua_getfield(state, -1, "loaders");
+#endif
+		if(! lua_istable(state, -1)) {
+			lua_settop(state, top);
+			ASMITH_LUA_THROW("asmith::Lua::ModuleCache::install : Package library has no searchers");
+		}
+
+		// Insert after the preload searcher so package.preload still takes priority
+		const int searchers = lua_gettop(state);
+		int count = 0;
+		while(lua_rawgeti(state, searchers, count + 1), ! lua_isnil(state, -1)) {
+			const bool installed = lua_tocfunction(state, -1) == implementation::moduleSearcher;
+			lua_pop(state, 1);
+			if(installed) {
+				lua_settop(state, top);
+				return;
+			}
+			++count;
+		}
+		lua_pop(state, 1);
+
+		const int position = count > 0 ? 2 : 1;
+		for(int i = count; i >= position; --i) {
+			lua_rawgeti(state, searchers, i);
+			lua_rawseti(state, searchers, i + 1);
+		}
+		lua_pushcfunction(state, implementation::moduleSearcher);
+		lua_rawseti(state, searchers, position);
+
+		lua_settop(state, top);
+	}
+
+	ASMITH_LUA_INLINE ModuleStats ModuleCache::getStats() {
+		ModuleStats stats;
+		const implementation::ModuleCounters& counters = implementation::moduleCounters();
+		stats.hits = counters.hits;
+		stats.misses = counters.misses;
+		stats.loadNanoseconds = counters.loadTime;
+		return stats;
+	}
+
+	ASMITH_LUA_INLINE void ModuleCache::resetStats() {
+		implementation::ModuleCounters& counters = implementation::moduleCounters();
+		counters.hits = 0;
+		counters.misses = 0;
+		counters.loadTime = 0;
+	}
+
+}}
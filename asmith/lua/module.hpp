@@ -0,0 +1,59 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#ifndef ASMITH_LUA_MODULE_HPP
+#define ASMITH_LUA_MODULE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "state.hpp"
+
+namespace asmith { namespace Lua {
+
+	struct ModuleStats {
+		uint64_t hits;			// require calls served from the cache
+		uint64_t misses;		// require calls passed on to the next searcher
+		uint64_t loadNanoseconds;	// Time spent loading cached chunks into states
+	};
+
+	// Process wide cache of precompiled modules.
+	// install adds a searcher to package.searchers that serves require from the cache,
+	// so states do not probe the filesystem for modules that have already been compiled.
+	class ModuleCache {
+	private:
+		ModuleCache() = delete;
+	public:
+		// Compiles source text (or accepts an already precompiled chunk) and caches it under aName.
+		// Throws if the source does not compile or the precompiled chunk does not load in this Lua build.
+		static void add(String aName, const char* aChunk, size_t aSize);
+		static bool contains(String aName);
+		static void clear();
+
+		// Archives are a header identifying the Lua build followed by [uint32 name length][name][uint32 chunk length][chunk] records.
+		// loadArchive throws if the archive was written by a different Lua version or bytecode format.
+		static void loadArchive(const char* aPath);
+		static void saveArchive(const char* aPath);
+
+		// Requires the package library to be open in the state, installing twice has no effect
+		static void install(State&);
+
+		static ModuleStats getStats();
+		static void resetStats();
+	};
+}}
+
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "module.cpp"
+#endif
+
+#endif
@@ -12,39 +12,40 @@
 //	limitations under the License.
 
 #include "asmith/lua/script.hpp"
+#include <cstring>
 #include <stdexcept>
 
 namespace asmith { namespace Lua {
 	// Script
 
-	Script::Script(State& aState) :
+	ASMITH_LUA_INLINE Script::Script(State& aState) :
 		mState(aState),
 		mLoaded(false)
 	{}
 
-	Script::~Script() {
+	ASMITH_LUA_INLINE Script::~Script() {
 
 	}
 
-	void Script::load(const char* aScript) {
+	ASMITH_LUA_INLINE void Script::load(const char* aScript) {
 		lua_State* const state = mState.getHandle();
 		int error = luaL_loadbuffer(state, aScript, strlen(aScript), "line");
 		if(error) {
 			const std::string errorMsg = lua_tostring(state, -1);
 			lua_pop(state, 1);
-			throw std::runtime_error("asmith::Lua::Script::load : " + errorMsg);
+			ASMITH_LUA_THROW("asmith::Lua::Script::load : " + errorMsg);
 		}
 		mLoaded = true;
 	}
 
-	void Script::operator()() {
-		if(! mLoaded) throw std::runtime_error("asmith::Lua::Script::load : Error loading script"); 
+	ASMITH_LUA_INLINE void Script::operator()() {
+		if(! mLoaded) ASMITH_LUA_THROW("asmith::Lua::Script::load : Error loading script"); 
 		lua_State* const state = mState.getHandle();
 		int error = lua_pcall(state, 0, 0, 0);
 		if(error) {
 			const std::string errorMsg = lua_tostring(state, -1);
 			lua_pop(state, 1);
-			throw std::runtime_error("asmith::Lua::Script::operator() : " + errorMsg);
+			ASMITH_LUA_THROW("asmith::Lua::Script::operator() : " + errorMsg);
 		}
 	}
 
@@ -35,4 +35,8 @@ namespace asmith { namespace Lua {
 	};
 }}
 
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "script.cpp"
+#endif
+
 #endif
\ No newline at end of file
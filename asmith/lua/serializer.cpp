@@ -0,0 +1,306 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "asmith/lua/serializer.hpp"
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+		ASMITH_LUA_INLINE int absoluteIndex(lua_State* aState, int aIndex) {
+			return aIndex > 0 || aIndex <= LUA_REGISTRYINDEX ? aIndex : lua_gettop(aState) + aIndex + 1;
+		}
+
+		// Writer
+
+		struct SerialWriter {
+			lua_State* state;
+			uint8_t* begin;
+			uint8_t* head;
+			uint8_t* end;
+			int references;
+			uint32_t nextID;
+
+			void write(const void* aData, size_t aSize) {
+				if(static_cast<size_t>(end - head) < aSize) ASMITH_LUA_THROW("asmith::Lua::Serializer::serialize : Buffer is too small");
+				memcpy(head, aData, aSize);
+				head += aSize;
+			}
+
+			void writeTag(Serializer::Tag aTag) {
+				const uint8_t tag = aTag;
+				write(&tag, 1);
+			}
+
+			void writeValue(int aIndex, int aDepth) {
+				switch(lua_type(state, aIndex)) {
+				case LUA_TNIL:
+					writeTag(Serializer::TAG_NIL);
+					break;
+				case LUA_TBOOLEAN:
+					writeTag(lua_toboolean(state, aIndex) ? Serializer::TAG_TRUE : Serializer::TAG_FALSE);
+					break;
+				case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+					if(lua_isinteger(state, aIndex)) {
+						const Integer value = lua_tointeger(state, aIndex);
+						writeTag(Serializer::TAG_INTEGER);
+						write(&value, sizeof(value));
+						break;
+					}
+#endif
+					{
+						const Number value = lua_tonumber(state, aIndex);
+						writeTag(Serializer::TAG_NUMBER);
+						write(&value, sizeof(value));
+					}
+					break;
+				case LUA_TSTRING:
+					{
+						size_t length = 0;
+						const char* const value = lua_tolstring(state, aIndex, &length);
+						if(length > UINT32_MAX) ASMITH_LUA_THROW("asmith::Lua::Serializer::serialize : String is too long");
+						const uint32_t length32 = static_cast<uint32_t>(length);
+						writeTag(Serializer::TAG_STRING);
+						write(&length32, sizeof(length32));
+						write(value, length);
+					}
+					break;
+				case LUA_TTABLE:
+					writeTable(aIndex, aDepth);
+					break;
+				default:
+					ASMITH_LUA_THROW(std::string("asmith::Lua::Serializer::serialize : Cannot serialize values of type ") + lua_typename(state, lua_type(state, aIndex)));
+				}
+			}
+
+			void writeTable(int aIndex, int aDepth) {
+				if(aDepth >= Serializer::MAX_DEPTH) ASMITH_LUA_THROW("asmith::Lua::Serializer::serialize : Tables are nested too deeply");
+				if(! lua_checkstack(state, 4)) ASMITH_LUA_THROW("asmith::Lua::Serializer::serialize : Lua stack overflow");
+
+				// Only the root value can be the first table, so nothing has been pushed above it yet
+				if(references == 0) {
+					lua_newtable(state);
+					references = lua_gettop(state);
+				}
+
+				// Tables that have already been written are replaced with a reference to their ID
+				lua_pushvalue(state, aIndex);
+				lua_rawget(state, references);
+				if(! lua_isnil(state, -1)) {
+					const uint32_t id = static_cast<uint32_t>(lua_tonumber(state, -1));
+					lua_pop(state, 1);
+					writeTag(Serializer::TAG_REFERENCE);
+					write(&id, sizeof(id));
+					return;
+				}
+				lua_pop(state, 1);
+
+				lua_pushvalue(state, aIndex);
+				lua_pushnumber(state, ++nextID);
+				lua_rawset(state, references);
+
+				writeTag(Serializer::TAG_TABLE);
+				lua_pushnil(state);
+				while(lua_next(state, aIndex) != 0) {
+					const int top = lua_gettop(state);
+					writeValue(top - 1, aDepth + 1);
+					writeValue(top, aDepth + 1);
+					lua_pop(state, 1);
+				}
+				writeTag(Serializer::TAG_TABLE_END);
+			}
+		};
+
+		// Reader
+
+		struct SerialReader {
+			lua_State* state;
+			const uint8_t* begin;
+			const uint8_t* head;
+			const uint8_t* end;
+			int references;
+			uint32_t nextID;
+
+			void read(void* aData, size_t aSize) {
+				if(static_cast<size_t>(end - head) < aSize) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Unexpected end of buffer");
+				memcpy(aData, head, aSize);
+				head += aSize;
+			}
+
+			Serializer::Tag readTag() {
+				uint8_t tag;
+				read(&tag, 1);
+				return static_cast<Serializer::Tag>(tag);
+			}
+
+			void readValue(int aDepth) {
+				if(! lua_checkstack(state, 3)) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Lua stack overflow");
+				readValue(readTag(), aDepth);
+			}
+
+			void readValue(Serializer::Tag aTag, int aDepth) {
+				switch(aTag) {
+				case Serializer::TAG_NIL:
+					lua_pushnil(state);
+					break;
+				case Serializer::TAG_FALSE:
+					lua_pushboolean(state, 0);
+					break;
+				case Serializer::TAG_TRUE:
+					lua_pushboolean(state, 1);
+					break;
+				case Serializer::TAG_INTEGER:
+					{
+						Integer value;
+						read(&value, sizeof(value));
+#if LUA_VERSION_NUM >= 503
+						lua_pushinteger(state, value);
+#else
+						lua_pushnumber(state, static_cast<Number>(value));
+#endif
+					}
+					break;
+				case Serializer::TAG_NUMBER:
+					{
+						Number value;
+						read(&value, sizeof(value));
+						lua_pushnumber(state, value);
+					}
+					break;
+				case Serializer::TAG_STRING:
+					{
+						uint32_t length;
+						read(&length, sizeof(length));
+						if(static_cast<size_t>(end - head) < length) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Unexpected end of buffer");
+						lua_pushlstring(state, reinterpret_cast<const char*>(head), length);
+						head += length;
+					}
+					break;
+				case Serializer::TAG_TABLE:
+					readTable(aDepth);
+					break;
+				case Serializer::TAG_REFERENCE:
+					{
+						uint32_t id;
+						read(&id, sizeof(id));
+						if(id == 0 || id > nextID || references == 0) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Invalid table reference");
+						lua_rawgeti(state, references, id);
+					}
+					break;
+				default:
+					ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Invalid tag");
+				}
+			}
+
+			void readTable(int aDepth) {
+				if(aDepth >= Serializer::MAX_DEPTH) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Tables are nested too deeply");
+
+				// Only the root value can be the first table, so nothing has been pushed above it yet
+				if(references == 0) {
+					lua_newtable(state);
+					references = lua_gettop(state);
+				}
+
+				lua_newtable(state);
+				lua_pushvalue(state, -1);
+				lua_rawseti(state, references, ++nextID);
+
+				for(Serializer::Tag tag = readTag(); tag != Serializer::TAG_TABLE_END; tag = readTag()) {
+					if(! lua_checkstack(state, 3)) ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Lua stack overflow");
+					readValue(tag, aDepth + 1);
+					// lua_rawset raises a Lua error on invalid keys, so they must be rejected here
+					if(lua_isnil(state, -1) || (lua_type(state, -1) == LUA_TNUMBER && lua_tonumber(state, -1) != lua_tonumber(state, -1))) {
+						ASMITH_LUA_THROW("asmith::Lua::Serializer::deserialize : Invalid table key");
+					}
+					readValue(aDepth + 1);
+					lua_rawset(state, -3);
+				}
+			}
+		};
+	}
+
+	// Serializer
+
+	ASMITH_LUA_INLINE Serializer::Serializer(State& aState) :
+		mState(aState)
+	{}
+
+	ASMITH_LUA_INLINE Serializer::~Serializer() {
+
+	}
+
+	ASMITH_LUA_INLINE size_t Serializer::serialize(int aIndex, void* aBuffer, size_t aSize) {
+		lua_State* const state = mState.getHandle();
+		const int index = implementation::absoluteIndex(state, aIndex);
+		const int top = lua_gettop(state);
+
+		implementation::SerialWriter writer;
+		writer.state = state;
+		writer.begin = static_cast<uint8_t*>(aBuffer);
+		writer.head = writer.begin;
+		writer.end = writer.begin + aSize;
+		writer.nextID = 0;
+
+		writer.references = 0;
+#ifdef ASMITH_LUA_NO_EXCEPTIONS
+		writer.writeValue(index, 0);
+#else
+		try {
+			writer.writeValue(index, 0);
+		} catch(...) {
+			lua_settop(state, top);
+			throw;
+		}
+#endif
+
+		lua_settop(state, top);
+		return writer.head - writer.begin;
+	}
+
+	ASMITH_LUA_INLINE size_t Serializer::deserialize(const void* aBuffer, size_t aSize) {
+		lua_State* const state = mState.getHandle();
+
+		implementation::SerialReader reader;
+		reader.state = state;
+		reader.begin = static_cast<const uint8_t*>(aBuffer);
+		reader.head = reader.begin;
+		reader.end = reader.begin + aSize;
+		reader.nextID = 0;
+
+		reader.references = 0;
+#ifdef ASMITH_LUA_NO_EXCEPTIONS
+		reader.readValue(0);
+#else
+		const int top = lua_gettop(state);
+		try {
+			reader.readValue(0);
+		} catch(...) {
+			lua_settop(state, top);
+			throw;
+		}
+#endif
+
+		if(reader.references != 0) lua_remove(state, reader.references);
+		return reader.head - reader.begin;
+	}
+
+	ASMITH_LUA_INLINE size_t Serializer::transfer(State& aSource, int aIndex, State& aDestination, void* aBuffer, size_t aSize) {
+		const size_t size = Serializer(aSource).serialize(aIndex, aBuffer, aSize);
+		return Serializer(aDestination).deserialize(aBuffer, size);
+	}
+
+}}
@@ -0,0 +1,68 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#ifndef ASMITH_LUA_SERIALIZER_HPP
+#define ASMITH_LUA_SERIALIZER_HPP
+
+#include <cstddef>
+#include "state.hpp"
+
+namespace asmith { namespace Lua {
+
+	// Encodes nil, boolean, integer, number, string and table values into a caller provided buffer.
+	// Tables are written once and referenced by ID after that, so shared and cyclic tables survive a round trip.
+	// The encoding uses native byte order and is intended for moving values between states in the same process.
+	class Serializer {
+	public:
+		enum Tag : uint8_t {
+			TAG_NIL,
+			TAG_FALSE,
+			TAG_TRUE,
+			TAG_INTEGER,
+			TAG_NUMBER,
+			TAG_STRING,
+			TAG_TABLE,
+			TAG_TABLE_END,
+			TAG_REFERENCE
+		};
+
+		enum {
+			MAX_DEPTH = 200
+		};
+	private:
+		State& mState;
+
+		Serializer(const Serializer&) = delete;
+		Serializer(Serializer&&) = delete;
+		Serializer& operator=(const Serializer&) = delete;
+		Serializer& operator=(Serializer&&) = delete;
+	public:
+		Serializer(State&);
+		~Serializer();
+
+		// Returns the number of bytes written, throws if the value does not fit in the buffer
+		size_t serialize(int aIndex, void* aBuffer, size_t aSize);
+
+		// Pushes the decoded value and returns the number of bytes read
+		size_t deserialize(const void* aBuffer, size_t aSize);
+
+		// Copies the value at aIndex in aSource to the top of aDestination, using aBuffer as scratch space
+		static size_t transfer(State& aSource, int aIndex, State& aDestination, void* aBuffer, size_t aSize);
+	};
+}}
+
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "serializer.cpp"
+#endif
+
+#endif
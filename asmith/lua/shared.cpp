@@ -0,0 +1,112 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "asmith/lua/shared.hpp"
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+		ASMITH_LUA_INLINE const char* sharedMetatable() {
+			return "asmith::Lua::SharedData";
+		}
+
+		// Segments are never removed, so views can hold raw pointers to them
+		ASMITH_LUA_INLINE std::mutex& sharedMutex() {
+			static std::mutex mutex;
+			return mutex;
+		}
+
+		ASMITH_LUA_INLINE std::map<std::string, std::unique_ptr<SharedSegment>>& sharedSegments() {
+			static std::map<std::string, std::unique_ptr<SharedSegment>> segments;
+			return segments;
+		}
+
+		ASMITH_LUA_INLINE const SharedSegment* checkSegment(lua_State* aState) {
+			return *static_cast<const SharedSegment**>(luaL_checkudata(aState, 1, sharedMetatable()));
+		}
+
+		ASMITH_LUA_INLINE int sharedIndex(lua_State* aState) {
+			checkSegment(aState)->index(aState);
+			return 1;
+		}
+
+		ASMITH_LUA_INLINE int sharedLength(lua_State* aState) {
+			lua_pushnumber(aState, static_cast<Number>(checkSegment(aState)->length()));
+			return 1;
+		}
+
+		ASMITH_LUA_INLINE int sharedNewIndex(lua_State* aState) {
+			return luaL_error(aState, "asmith::Lua::SharedData : Shared data is read-only");
+		}
+
+		ASMITH_LUA_INLINE void pushSegment(lua_State* aState, const SharedSegment* aSegment) {
+			const SharedSegment** const view = static_cast<const SharedSegment**>(lua_newuserdata(aState, sizeof(SharedSegment*)));
+			*view = aSegment;
+			if(luaL_newmetatable(aState, sharedMetatable())) {
+				lua_pushcfunction(aState, sharedIndex);
+				lua_setfield(aState, -2, "__index");
+				lua_pushcfunction(aState, sharedLength);
+				lua_setfield(aState, -2, "__len");
+				lua_pushcfunction(aState, sharedNewIndex);
+				lua_setfield(aState, -2, "__newindex");
+				lua_pushboolean(aState, 0);
+				lua_setfield(aState, -2, "__metatable");
+			}
+			lua_setmetatable(aState, -2);
+		}
+	}
+
+	// SharedData
+
+	ASMITH_LUA_INLINE void SharedData::add(String aName, implementation::SharedSegment* aSegment) {
+		std::unique_ptr<implementation::SharedSegment> segment(aSegment);
+		std::lock_guard<std::mutex> lock(implementation::sharedMutex());
+		std::unique_ptr<implementation::SharedSegment>& slot = implementation::sharedSegments()[aName];
+		if(slot) ASMITH_LUA_THROW(std::string("asmith::Lua::SharedData::add : Segment already registered : ") + aName);
+		slot.swap(segment);
+	}
+
+	ASMITH_LUA_INLINE void SharedData::push(State& aState, String aName) {
+		const implementation::SharedSegment* segment = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(implementation::sharedMutex());
+			const auto i = implementation::sharedSegments().find(aName);
+			if(i != implementation::sharedSegments().end()) segment = i->second.get();
+		}
+		if(! segment) ASMITH_LUA_THROW(std::string("asmith::Lua::SharedData::push : No segment registered : ") + aName);
+		implementation::pushSegment(aState.getHandle(), segment);
+	}
+
+	ASMITH_LUA_INLINE void SharedData::expose(State& aState) {
+		// Lua can raise errors while pushing, so the registry is copied out rather than locked during the loop
+		std::vector<std::pair<std::string, const implementation::SharedSegment*>> segments;
+		{
+			std::lock_guard<std::mutex> lock(implementation::sharedMutex());
+			segments.reserve(implementation::sharedSegments().size());
+			for(const auto& i : implementation::sharedSegments()) segments.push_back(std::make_pair(i.first, i.second.get()));
+		}
+
+		lua_State* const state = aState.getHandle();
+		for(const auto& i : segments) {
+			implementation::pushSegment(state, i.second);
+			lua_setglobal(state, i.first.c_str());
+		}
+	}
+
+}}
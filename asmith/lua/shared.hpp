@@ -0,0 +1,140 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#ifndef ASMITH_LUA_SHARED_HPP
+#define ASMITH_LUA_SHARED_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "state.hpp"
+
+namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+	// A block of immutable C++ owned data that is viewed from Lua through userdata
+	class SharedSegment {
+	public:
+		virtual ~SharedSegment() {}
+		// Pushes the value for the key at index 2, or nil if there is no such key
+		virtual void index(lua_State*) const = 0;
+		virtual size_t length() const = 0;
+	};
+
+	template<class T>
+	class SharedArraySegment : public SharedSegment {
+	private:
+		const T* const mData;
+		const size_t mSize;
+	public:
+		SharedArraySegment(const T* aData, size_t aSize) :
+			mData(aData),
+			mSize(aSize)
+		{}
+
+		void index(lua_State* aState) const override {
+			// The range is checked before converting, as converting NaN or an out of range number to size_t is undefined
+			const Number key = lua_type(aState, 2) == LUA_TNUMBER ? lua_tonumber(aState, 2) : 0.0;
+			if(key >= 1.0 && key <= static_cast<Number>(mSize)) {
+				const size_t i = static_cast<size_t>(key);
+				if(static_cast<Number>(i) == key) {
+					push<T>(aState, mData[i - 1]);
+					return;
+				}
+			}
+			lua_pushnil(aState);
+		}
+
+		size_t length() const override {
+			return mSize;
+		}
+	};
+
+	// Compares bytes as unsigned char, which is the order std::string and so std::map use
+	inline int compareSharedKey(const std::string& aKey, const char* aOther, size_t aLength) {
+		const int result = memcmp(aKey.data(), aOther, std::min(aKey.size(), aLength));
+		if(result != 0) return result;
+		return aKey.size() < aLength ? -1 : aKey.size() > aLength ? 1 : 0;
+	}
+
+	template<class T>
+	class SharedMapSegment : public SharedSegment {
+	private:
+		typedef std::pair<const std::string, T> Entry;
+
+		// Entries in map order, so Lua strings can be looked up without copying them into a std::string
+		std::vector<const Entry*> mEntries;
+	public:
+		SharedMapSegment(const std::map<std::string, T>& aMap) {
+			mEntries.reserve(aMap.size());
+			for(const Entry& i : aMap) mEntries.push_back(&i);
+		}
+
+		void index(lua_State* aState) const override {
+			size_t length = 0;
+			const char* const key = lua_type(aState, 2) == LUA_TSTRING ? lua_tolstring(aState, 2, &length) : nullptr;
+			if(key) {
+				const auto i = std::lower_bound(mEntries.begin(), mEntries.end(), key, [length](const Entry* aEntry, const char* aKey)->bool {
+					return compareSharedKey(aEntry->first, aKey, length) < 0;
+				});
+				if(i != mEntries.end() && compareSharedKey((*i)->first, key, length) == 0) {
+					push<T>(aState, (*i)->second);
+					return;
+				}
+			}
+			lua_pushnil(aState);
+		}
+
+		size_t length() const override {
+			return mEntries.size();
+		}
+	};
+
+	}
+
+	// Process wide registry of read-only data.
+	// Data is registered once and every State sees it through a userdata view with __index and __len,
+	// so lookups read the C++ memory directly instead of copying it into each Lua heap.
+	// The registered data must outlive every State it is exposed to and must not be modified.
+	class SharedData {
+	private:
+		SharedData() = delete;
+
+		static void add(String, implementation::SharedSegment*);
+	public:
+		template<class T>
+		static void addArray(String aName, const T* aData, size_t aSize) {
+			add(aName, new implementation::SharedArraySegment<T>(aData, aSize));
+		}
+
+		template<class T>
+		static void addMap(String aName, const std::map<std::string, T>& aMap) {
+			add(aName, new implementation::SharedMapSegment<T>(aMap));
+		}
+
+		// Pushes a view of a single segment
+		static void push(State&, String aName);
+		// Sets a global view for every registered segment
+		static void expose(State&);
+	};
+}}
+
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "shared.cpp"
+#endif
+
+#endif
@@ -12,27 +12,171 @@
 //	limitations under the License.
 
 #include "asmith/lua/state.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <stdexcept>
 
 namespace asmith { namespace Lua {
+
+	namespace implementation {
+
+		ASMITH_LUA_INLINE void defaultErrorHandler(const char* aMessage) {
+			fprintf(stderr, "%s\n", aMessage);
+		}
+
+		ASMITH_LUA_INLINE ErrorHandler& errorHandler() {
+			static ErrorHandler handler = defaultErrorHandler;
+			return handler;
+		}
+
+		ASMITH_LUA_INLINE void fail(const char* aMessage) {
+			errorHandler()(aMessage ? aMessage : "asmith::Lua : Unknown error");
+			abort();
+		}
+
+		ASMITH_LUA_INLINE void fail(const std::string& aMessage) {
+			fail(aMessage.c_str());
+		}
+
+		// The address of the static is the registry key for the cached bind function
+		ASMITH_LUA_INLINE void* ffiBindKey() {
+			static const char key = 0;
+			return const_cast<char*>(&key);
+		}
+
+		// Returns false if the FFI library cannot be loaded, otherwise a function that casts the function pointer
+		// and passes it to a generated wrapper, along with the helpers shared by every wrapper.
+		// number converts numeric strings like luaL_checknumber, it is only reached when the argument is not a number.
+		ASMITH_LUA_INLINE const char* ffiBindSource() {
+			return
+				"local ok, ffi = pcall(require, 'ffi') "
+				"if not ok then return false end "
+				"local cast, type, error, tonumber = ffi.cast, type, error, tonumber "
+				"local function fail(argument, message) error('bad argument #' .. argument .. ' (' .. message .. ')', 3) end "
+				"local function number(argument, value, index) "
+				"local n = type(value) == 'string' and tonumber(value) or nil "
+				"if n == nil then error('bad argument #' .. argument .. ' (number expected' .. (index and ' at index ' .. index or '') .. ', got ' .. type(value) .. ')', 3) end "
+				"return n end "
+				"return function(wrapper, signature, pointer) return wrapper(cast(signature, pointer), fail, number, type) end";
+		}
+
+		// Builds a wrapper with a fixed parameter list, so compiled traces call the FFI pointer directly.
+		// The checks mirror checkFast, so the FFI only ever sees numbers and booleans.
+		ASMITH_LUA_INLINE std::string ffiWrapperSource(const char* aTypes, bool aReturns, bool aArray) {
+			const int count = static_cast<int>(strlen(aTypes));
+			std::string params;
+			std::string values;
+			std::string tables;
+			std::string isTable;
+			std::string lengths;
+			std::string checks;
+			std::string elements;
+			for(int i = 1; i <= count; ++i) {
+				const std::string n = std::to_string(i);
+				const std::string separator = i > 1 ? ", " : "";
+				const bool boolean = aTypes[i - 1] == 'b';
+				params += separator + "a" + n;
+				values += separator + "v" + n;
+				tables += separator + "t" + n;
+				isTable += separator + "type(a" + n + ") == 'table'";
+				lengths +=
+					"if t" + n + " then if n == nil then n = #a" + n + " elseif #a" + n + " ~= n then "
+					"fail(" + n + ", 'arrays must have the same length') end end ";
+				if(boolean) {
+					checks +=
+						"if type(a" + n + ") ~= 'boolean' then fail(" + n + ", 'boolean expected, got ' .. type(a" + n + ")) end ";
+					elements +=
+						"if t" + n + " then v" + n + " = a" + n + "[i] end "
+						"if type(v" + n + ") ~= 'boolean' then "
+						"fail(" + n + ", 'boolean expected' .. (t" + n + " and ' at index ' .. i or '') .. ', got ' .. type(v" + n + ")) end ";
+				} else {
+					checks +=
+						"if type(a" + n + ") ~= 'number' then a" + n + " = number(" + n + ", a" + n + ") end ";
+					elements +=
+						"if t" + n + " then v" + n + " = a" + n + "[i] end "
+						"if type(v" + n + ") ~= 'number' then v" + n + " = number(" + n + ", v" + n + ", t" + n + " and i or nil) end ";
+				}
+			}
+
+			if(! aArray || count == 0) {
+				return
+					"local f, fail, number, type = ... "
+					"return function(" + params + ") " +
+					checks +
+					"return f(" + params + ") end";
+			}
+
+			return
+				"local f, fail, number, type = ... "
+				"return function(" + params + ") "
+				"local n, " + tables + " = nil, " + isTable + " " +
+				lengths +
+				"if n == nil then fail(1, 'array expected') end " +
+				std::string(aReturns ? "local r = {} " : "") +
+				"for i = 1, n do "
+				"local " + values + " = " + params + " " +
+				elements +
+				(aReturns ? "r[i] = f(" + values + ") " : "f(" + values + ") ") +
+				"end " +
+				(aReturns ? "return r " : "") +
+				"end";
+		}
+
+		ASMITH_LUA_INLINE bool pushFfiFunction(lua_State* aState, const char* aSignature, void* aFunction, const char* aTypes, bool aReturns, bool aArray) {
+			const int top = lua_gettop(aState);
+			lua_pushlightuserdata(aState, ffiBindKey());
+			lua_rawget(aState, LUA_REGISTRYINDEX);
+			if(lua_isnil(aState, -1)) {
+				// Only success is cached, so a state that opens its libraries later still gets the FFI path
+				lua_pop(aState, 1);
+				if(luaL_loadbuffer(aState, ffiBindSource(), strlen(ffiBindSource()), "=asmith::Lua::pushFast") != 0 || lua_pcall(aState, 0, 1, 0) != 0 || ! lua_isfunction(aState, -1)) {
+					lua_settop(aState, top);
+					return false;
+				}
+				lua_pushlightuserdata(aState, ffiBindKey());
+				lua_pushvalue(aState, -2);
+				lua_rawset(aState, LUA_REGISTRYINDEX);
+			}
+
+			// bind(wrapper, signature, function)
+			const std::string wrapper = ffiWrapperSource(aTypes, aReturns, aArray);
+			if(luaL_loadbuffer(aState, wrapper.c_str(), wrapper.size(), "=asmith::Lua::pushFast") != 0) {
+				lua_settop(aState, top);
+				return false;
+			}
+			lua_pushstring(aState, aSignature);
+			lua_pushlightuserdata(aState, aFunction);
+			if(lua_pcall(aState, 3, 1, 0) != 0) {
+				lua_settop(aState, top);
+				return false;
+			}
+			return true;
+		}
+	}
+
+	ASMITH_LUA_INLINE void setErrorHandler(ErrorHandler aHandler) {
+		implementation::errorHandler() = aHandler ? aHandler : implementation::defaultErrorHandler;
+	}
+
 	// State
 
-	State::State() :
+	ASMITH_LUA_INLINE State::State() :
 		mState(luaL_newstate())
 	{
-		if(! mState) throw std::runtime_error("asmith::Lua::State : Failed to create Lua state");
+		if(! mState) ASMITH_LUA_THROW("asmith::Lua::State : Failed to create Lua state");
 	}
 
-	State::~State() {
-		if(! mState) lua_close(mState);
+	ASMITH_LUA_INLINE State::~State() {
+		if(mState) lua_close(mState);
 	}
 
 
-	void State::setGlobal(String aName) {
+	ASMITH_LUA_INLINE void State::setGlobal(String aName) {
 		lua_setglobal(mState, aName);
 	}
 
-	lua_State* State::getHandle() throw() {
+	ASMITH_LUA_INLINE lua_State* State::getHandle() throw() {
 		return mState;
 	}
 
@@ -14,11 +14,30 @@
 #ifndef ASMITH_LUA_STATE_HPP
 #define ASMITH_LUA_STATE_HPP
 
+#include <climits>
 #include <cstdint>
 #include <stdexcept>
+#include <string>
 #include <functional>
+#include <tuple>
+#include <type_traits>
 #include "lua/lua.hpp"
 
+// Building with ASMITH_LUA_NO_EXCEPTIONS replaces every throw with a call to the error handler followed by abort
+#ifdef ASMITH_LUA_NO_EXCEPTIONS
+	#define ASMITH_LUA_THROW(aMessage) ::asmith::Lua::implementation::fail(aMessage)
+#else
+	#define ASMITH_LUA_THROW(aMessage) throw std::runtime_error(aMessage)
+#endif
+
+// Building with ASMITH_LUA_HEADER_ONLY includes each source file from its header with every definition inline.
+// Process wide state lives in function local statics, so inline definitions still share one copy per program.
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#define ASMITH_LUA_INLINE inline
+#else
+	#define ASMITH_LUA_INLINE
+#endif
+
 namespace asmith { namespace Lua {
 
 	typedef void Nil;
@@ -27,6 +46,9 @@ namespace asmith { namespace Lua {
 	typedef double Number;
 	typedef const char* String;
 	typedef int(*Callback)(lua_State*);
+	typedef void(*ErrorHandler)(const char*);
+
+	void setErrorHandler(ErrorHandler);
 
 	enum Type {
 		ERROR_TYPE,
@@ -40,7 +62,7 @@ namespace asmith { namespace Lua {
 	};
 
 	template<class T>
-	static Type typeOf() {
+	inline Type typeOf() {
 		return
 			std::is_same<T, Nil>::value ? NIL :
 			std::is_same<T, Boolean>::value ? BOOLEAN :
@@ -52,132 +74,135 @@ namespace asmith { namespace Lua {
 
 	namespace implementation {
 
+	[[noreturn]] void fail(const char*);
+	[[noreturn]] void fail(const std::string&);
+
 	// lua_pushX
 	template<class T>
-	static void push(lua_State* aState, T aValue);
+	inline void push(lua_State* aState, T aValue);
 
 	template<>
-	static void push<Boolean>(lua_State* aState, Boolean aValue) {
+	inline void push<Boolean>(lua_State* aState, Boolean aValue) {
 		lua_pushboolean(aState, aValue);
 	}
 
 	template<>
-	static void push<uint8_t>(lua_State* aState, uint8_t aValue) {
+	inline void push<uint8_t>(lua_State* aState, uint8_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<uint16_t>(lua_State* aState, uint16_t aValue) {
+	inline void push<uint16_t>(lua_State* aState, uint16_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<uint32_t>(lua_State* aState, uint32_t aValue) {
+	inline void push<uint32_t>(lua_State* aState, uint32_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<uint64_t>(lua_State* aState, uint64_t aValue) {
+	inline void push<uint64_t>(lua_State* aState, uint64_t aValue) {
 		lua_pushnumber(aState, (Number) aValue);
 	}
 
 	template<>
-	static void push<int8_t>(lua_State* aState, int8_t aValue) {
+	inline void push<int8_t>(lua_State* aState, int8_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<int16_t>(lua_State* aState, int16_t aValue) {
+	inline void push<int16_t>(lua_State* aState, int16_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<int32_t>(lua_State* aState, int32_t aValue) {
+	inline void push<int32_t>(lua_State* aState, int32_t aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<int64_t>(lua_State* aState, int64_t aValue) {
+	inline void push<int64_t>(lua_State* aState, int64_t aValue) {
 		lua_pushnumber(aState, (Number) aValue);
 	}
 
 	template<>
-	static void push<float>(lua_State* aState, float aValue) {
+	inline void push<float>(lua_State* aState, float aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<double>(lua_State* aState, double aValue) {
+	inline void push<double>(lua_State* aState, double aValue) {
 		lua_pushnumber(aState, aValue);
 	}
 
 	template<>
-	static void push<String>(lua_State* aState, String aValue) {
+	inline void push<String>(lua_State* aState, String aValue) {
 		lua_pushstring(aState, aValue);
 	}
 
 	// lua_toX
 
 	template<class T>
-	static T to(lua_State* aState, int aIndex);
+	inline T to(lua_State* aState, int aIndex);
 
 	template<>
-	static Boolean to<Boolean>(lua_State* aState, int aIndex) {
+	inline Boolean to<Boolean>(lua_State* aState, int aIndex) {
 		return lua_toboolean(aState, aIndex);
 	}
 
 	template<>
-	static uint8_t to<uint8_t>(lua_State* aState, int aIndex) {
+	inline uint8_t to<uint8_t>(lua_State* aState, int aIndex) {
 		return (uint8_t) lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static uint16_t to<uint16_t>(lua_State* aState, int aIndex) {
+	inline uint16_t to<uint16_t>(lua_State* aState, int aIndex) {
 		return (uint16_t) lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static uint32_t to<uint32_t>(lua_State* aState, int aIndex) {
+	inline uint32_t to<uint32_t>(lua_State* aState, int aIndex) {
 		return (uint32_t) lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static uint64_t to<uint64_t>(lua_State* aState, int aIndex) {
+	inline uint64_t to<uint64_t>(lua_State* aState, int aIndex) {
 		return (uint64_t) lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static int8_t to<int8_t>(lua_State* aState, int aIndex) {
+	inline int8_t to<int8_t>(lua_State* aState, int aIndex) {
 		return (int8_t)lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static int16_t to<int16_t>(lua_State* aState, int aIndex) {
+	inline int16_t to<int16_t>(lua_State* aState, int aIndex) {
 		return (int16_t)lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static int32_t to<int32_t>(lua_State* aState, int aIndex) {
+	inline int32_t to<int32_t>(lua_State* aState, int aIndex) {
 		return (int32_t)lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static int64_t to<int64_t>(lua_State* aState, int aIndex) {
+	inline int64_t to<int64_t>(lua_State* aState, int aIndex) {
 		return (int64_t)lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static float to<float>(lua_State* aState, int aIndex) {
+	inline float to<float>(lua_State* aState, int aIndex) {
 		return (float) lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static double to<double>(lua_State* aState, int aIndex) {
+	inline double to<double>(lua_State* aState, int aIndex) {
 		return lua_tonumber(aState, aIndex);
 	}
 
 	template<>
-	static String to<String>(lua_State* aState, int aIndex) {
+	inline String to<String>(lua_State* aState, int aIndex) {
 		return lua_tostring(aState, aIndex);
 	}
 
@@ -248,7 +273,7 @@ namespace asmith { namespace Lua {
 			P1 p1 = to<P1>(aState, 2);
 			P2 p2 = to<P2>(aState, 3);
 			P3 p3 = to<P3>(aState, 4);
-			P4 p4 = to<P4>(aState, 4);
+			P4 p4 = to<P4>(aState, 5);
 			R tmp = FUN(p0, p1, p2, p3, p4);
 			push<R>(aState, tmp);
 			return 1;
@@ -262,8 +287,8 @@ namespace asmith { namespace Lua {
 			P1 p1 = to<P1>(aState, 2);
 			P2 p2 = to<P2>(aState, 3);
 			P3 p3 = to<P3>(aState, 4);
-			P4 p4 = to<P4>(aState, 4);
-			P5 p5 = to<P5>(aState, 5);
+			P4 p4 = to<P4>(aState, 5);
+			P5 p5 = to<P5>(aState, 6);
 			R tmp = FUN(p0, p1, p2, p3, p4, p5);
 			push<R>(aState, tmp);
 			return 1;
@@ -327,7 +352,7 @@ namespace asmith { namespace Lua {
 			P1 p1 = to<P1>(aState, 2);
 			P2 p2 = to<P2>(aState, 3);
 			P3 p3 = to<P3>(aState, 4);
-			P4 p4 = to<P4>(aState, 4);
+			P4 p4 = to<P4>(aState, 5);
 			FUN(p0, p1, p2, p3, p4);
 			return 0;
 		}
@@ -340,13 +365,253 @@ namespace asmith { namespace Lua {
 			P1 p1 = to<P1>(aState, 2);
 			P2 p2 = to<P2>(aState, 3);
 			P3 p3 = to<P3>(aState, 4);
-			P4 p4 = to<P4>(aState, 4);
-			P5 p5 = to<P5>(aState, 5);
+			P4 p4 = to<P4>(aState, 5);
+			P5 p5 = to<P5>(aState, 6);
 			FUN(p0, p1, p2, p3, p4, p5);
 			return 0;
 		}
 	};
 
+	// Fast function wrapper
+
+	// Types that can cross the boundary without allocation.
+	// ffi is set when LuaJIT converts the type to a plain Lua value, so calls can go through an FFI function pointer.
+	template<class T>
+	struct FastType {
+		enum { trivial = 0, ffi = 0 };
+	};
+
+	template<> struct FastType<void> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "void"; } };
+	template<> struct FastType<Boolean> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "bool"; } };
+	template<> struct FastType<uint8_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "uint8_t"; } };
+	template<> struct FastType<uint16_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "uint16_t"; } };
+	template<> struct FastType<uint32_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "uint32_t"; } };
+	template<> struct FastType<uint64_t> { enum { trivial = 1, ffi = 0 }; static const char* name() { return "uint64_t"; } };
+	template<> struct FastType<int8_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "int8_t"; } };
+	template<> struct FastType<int16_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "int16_t"; } };
+	template<> struct FastType<int32_t> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "int32_t"; } };
+	template<> struct FastType<int64_t> { enum { trivial = 1, ffi = 0 }; static const char* name() { return "int64_t"; } };
+	template<> struct FastType<float> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "float"; } };
+	template<> struct FastType<double> { enum { trivial = 1, ffi = 1 }; static const char* name() { return "double"; } };
+
+	template<class...PARAMS>
+	struct FastParams {
+		enum { trivial = 1, ffi = 1 };
+	};
+
+	template<class P0, class...PARAMS>
+	struct FastParams<P0, PARAMS...> {
+		enum {
+			trivial = FastType<P0>::trivial && FastParams<PARAMS...>::trivial,
+			ffi = FastType<P0>::ffi && FastParams<PARAMS...>::ffi
+		};
+	};
+
+	template<size_t...I>
+	struct Indices {};
+
+	template<size_t N, size_t...I>
+	struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+	template<size_t...I>
+	struct MakeIndices<0, I...> {
+		typedef Indices<I...> Type;
+	};
+
+	// Pushes a Lua function that checks its arguments in the same way as FastFunctionWrapper, then calls aFunction
+	// through a LuaJIT FFI function pointer with the C type aSignature. aTypes has one character per parameter,
+	// 'b' for booleans and 'n' for numbers. aArray selects the array form, see FastFunctionWrapper::array.
+	// Returns false without pushing anything if the FFI library cannot be loaded.
+	bool pushFfiFunction(lua_State* aState, const char* aSignature, void* aFunction, const char* aTypes, bool aReturns, bool aArray);
+
+	template<class R, class...PARAMS>
+	inline std::string ffiSignature() {
+		const char* const names[] = { FastType<PARAMS>::name()..., nullptr };
+		std::string signature = FastType<R>::name();
+		signature += "(*)(";
+		for(size_t i = 0; i < sizeof...(PARAMS); ++i) {
+			if(i > 0) signature += ", ";
+			signature += names[i];
+		}
+		signature += ")";
+		return signature;
+	}
+
+	template<class...PARAMS>
+	inline std::string ffiTypes() {
+		const char types[] = { (std::is_same<PARAMS, Boolean>::value ? 'b' : 'n')..., '\0' };
+		return types;
+	}
+
+	inline size_t tableLength(lua_State* aState, int aIndex) {
+#if LUA_VERSION_NUM >= 502
+		return lua_rawlen(aState, aIndex);
+#else
+		return lua_objlen(aState, aIndex);
+#endif
+	}
+
+	// Raises "bad argument" for the value at aIndex, aElement is the array index or 0 for a scalar argument
+	inline void fastArgumentError(lua_State* aState, int aIndex, int aArgument, size_t aElement, const char* aExpected) {
+		const char* const got = lua_isnone(aState, aIndex) ? "nil" : luaL_typename(aState, aIndex);
+		if(aElement == 0) {
+			luaL_argerror(aState, aArgument, lua_pushfstring(aState, "%s expected, got %s", aExpected, got));
+		} else {
+			luaL_argerror(aState, aArgument, lua_pushfstring(aState, "%s expected at index %d, got %s", aExpected, static_cast<int>(aElement), got));
+		}
+	}
+
+	// Converts the value at aIndex the way luaL_checknumber does, returning false if it is not a number or numeric string
+	inline bool toFastNumber(lua_State* aState, int aIndex, Number& aValue) {
+#if LUA_VERSION_NUM >= 502
+		int isNumber = 0;
+		aValue = lua_tonumberx(aState, aIndex, &isNumber);
+		return isNumber != 0;
+#else
+		aValue = lua_tonumber(aState, aIndex);
+		return aValue != 0 || lua_isnumber(aState, aIndex);
+#endif
+	}
+
+	// Numbers follow luaL_checknumber and booleans must be Lua booleans. The LuaJIT wrappers in state.cpp check
+	// arguments the same way before they reach the FFI, so both builds accept and reject the same calls.
+	template<class T>
+	inline T checkFast(lua_State* aState, int aIndex, int aArgument, size_t aElement) {
+		Number value;
+		if(! toFastNumber(aState, aIndex, value)) fastArgumentError(aState, aIndex, aArgument, aElement, "number");
+		return static_cast<T>(value);
+	}
+
+	template<>
+	inline Boolean checkFast<Boolean>(lua_State* aState, int aIndex, int aArgument, size_t aElement) {
+		if(lua_type(aState, aIndex) != LUA_TBOOLEAN) fastArgumentError(aState, aIndex, aArgument, aElement, "boolean");
+		return lua_toboolean(aState, aIndex) != 0;
+	}
+
+	// Reads element aElement of an array argument, or the argument itself if it is a scalar.
+	// Elements are left on the stack so the caller can remove all of them with one lua_settop.
+	template<class T>
+	inline T checkFastElement(lua_State* aState, int aArgument, unsigned aArrays, size_t aElement) {
+		if((aArrays & (1u << (aArgument - 1))) == 0) return checkFast<T>(aState, aArgument, aArgument, 0);
+		lua_rawgeti(aState, aArgument, static_cast<int>(aElement));
+		return checkFast<T>(aState, -1, aArgument, aElement);
+	}
+
+	// Returns a bit per argument that is a table and sets aLength to their common length.
+	// Raises a Lua error if there are no tables or if they have different lengths.
+	inline unsigned fastArrays(lua_State* aState, int aCount, size_t& aLength) {
+		unsigned arrays = 0;
+		for(int i = 1; i <= aCount; ++i) {
+			if(lua_type(aState, i) != LUA_TTABLE) continue;
+			const size_t length = tableLength(aState, i);
+			if(arrays == 0) {
+				aLength = length;
+			} else if(length != aLength) {
+				luaL_argerror(aState, i, "arrays must have the same length");
+			}
+			arrays |= 1u << (i - 1);
+		}
+		if(arrays == 0) luaL_argerror(aState, 1, "array expected");
+		if(aLength > INT_MAX) luaL_argerror(aState, 1, "array is too long");
+		return arrays;
+	}
+
+	// wrapper converts the arguments with checkFast and calls FUN once.
+	// array accepts tables of arguments, calls FUN once per element and returns a table of the results,
+	// so a whole array crosses the boundary in one call. Scalar arguments are passed unchanged to every call.
+	template<class F, F FUN>
+	struct FastFunctionWrapper;
+
+	template<class R, class...PARAMS, R(*FUN)(PARAMS...)>
+	struct FastFunctionWrapper<R(*)(PARAMS...), FUN> {
+		enum { COUNT = sizeof...(PARAMS) };
+
+		// Braced initialisation converts the arguments from left to right, so the first bad argument is reported
+		template<size_t...I>
+		static R invoke(lua_State* aState, Indices<I...>) {
+			const std::tuple<PARAMS...> params{ checkFast<PARAMS>(aState, static_cast<int>(I) + 1, static_cast<int>(I) + 1, 0)... };
+			return FUN(std::get<I>(params)...);
+		}
+
+		template<size_t...I>
+		static R invoke(lua_State* aState, unsigned aArrays, size_t aElement, Indices<I...>) {
+			const std::tuple<PARAMS...> params{ checkFastElement<PARAMS>(aState, static_cast<int>(I) + 1, aArrays, aElement)... };
+			return FUN(std::get<I>(params)...);
+		}
+
+		static int wrapper(lua_State* aState) {
+			push<R>(aState, invoke(aState, typename MakeIndices<COUNT>::Type()));
+			return 1;
+		}
+
+		static int array(lua_State* aState) {
+			size_t size = 0;
+			const unsigned arrays = fastArrays(aState, COUNT, size);
+			lua_settop(aState, COUNT);
+			luaL_checkstack(aState, COUNT + 3, "asmith::Lua::State::pushFastArray");
+			lua_createtable(aState, static_cast<int>(size), 0);
+			const int results = COUNT + 1;
+			for(size_t i = 1; i <= size; ++i) {
+				push<R>(aState, invoke(aState, arrays, i, typename MakeIndices<COUNT>::Type()));
+				lua_rawseti(aState, results, static_cast<int>(i));
+				lua_settop(aState, results);
+			}
+			return 1;
+		}
+	};
+
+	template<class...PARAMS, void(*FUN)(PARAMS...)>
+	struct FastFunctionWrapper<void(*)(PARAMS...), FUN> {
+		enum { COUNT = sizeof...(PARAMS) };
+
+		template<size_t...I>
+		static void invoke(lua_State* aState, Indices<I...>) {
+			const std::tuple<PARAMS...> params{ checkFast<PARAMS>(aState, static_cast<int>(I) + 1, static_cast<int>(I) + 1, 0)... };
+			FUN(std::get<I>(params)...);
+		}
+
+		template<size_t...I>
+		static void invoke(lua_State* aState, unsigned aArrays, size_t aElement, Indices<I...>) {
+			const std::tuple<PARAMS...> params{ checkFastElement<PARAMS>(aState, static_cast<int>(I) + 1, aArrays, aElement)... };
+			FUN(std::get<I>(params)...);
+		}
+
+		static int wrapper(lua_State* aState) {
+			invoke(aState, typename MakeIndices<COUNT>::Type());
+			return 0;
+		}
+
+		static int array(lua_State* aState) {
+			size_t size = 0;
+			const unsigned arrays = fastArrays(aState, COUNT, size);
+			lua_settop(aState, COUNT);
+			luaL_checkstack(aState, COUNT + 2, "asmith::Lua::State::pushFastArray");
+			for(size_t i = 1; i <= size; ++i) {
+				invoke(aState, arrays, i, typename MakeIndices<COUNT>::Type());
+				lua_settop(aState, COUNT);
+			}
+			return 0;
+		}
+	};
+
+	template<class R, class...PARAMS>
+	struct FastFunction {
+		static_assert(FastType<R>::trivial && FastParams<PARAMS...>::trivial, "asmith::Lua::State::pushFast : Only booleans and numbers can be passed through fast functions");
+
+		template<R(*FUN)(PARAMS...)>
+		static void push(lua_State* aState, bool aArray) {
+#ifdef LUAJIT_VERSION
+			if(FastType<R>::ffi && FastParams<PARAMS...>::ffi) {
+				static const std::string signature = ffiSignature<R, PARAMS...>();
+				static const std::string types = ffiTypes<PARAMS...>();
+				if(pushFfiFunction(aState, signature.c_str(), reinterpret_cast<void*>(FUN), types.c_str(), ! std::is_void<R>::value, aArray)) return;
+			}
+#endif
+			typedef FastFunctionWrapper<R(*)(PARAMS...), FUN> Wrapper;
+			lua_pushcfunction(aState, aArray ? Wrapper::array : Wrapper::wrapper);
+		}
+	};
+
 	// Lua function call
 
 	template<class R, class...PARAMS>
@@ -356,7 +621,7 @@ namespace asmith { namespace Lua {
 	struct LuaFunctionWrapper<void> {
 		static void call(lua_State* aState, String aName) {
 			lua_getglobal(aState, aName);
-			if(lua_pcall(aState, 0, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 0, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -365,7 +630,7 @@ namespace asmith { namespace Lua {
 		static void call(lua_State* aState, String aName, P0 aP0) {
 			lua_getglobal(aState, aName);
 			push<P0>(aState, aP0);
-			if(lua_pcall(aState, 1, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 1, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -375,7 +640,7 @@ namespace asmith { namespace Lua {
 			lua_getglobal(aState, aName);
 			push<P0>(aState, aP0);
 			push<P1>(aState, aP1);
-			if(lua_pcall(aState, 2, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 2, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -386,7 +651,7 @@ namespace asmith { namespace Lua {
 			push<P0>(aState, aP0);
 			push<P1>(aState, aP1);
 			push<P2>(aState, aP2);
-			if(lua_pcall(aState, 3, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 3, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -398,7 +663,7 @@ namespace asmith { namespace Lua {
 			push<P1>(aState, aP1);
 			push<P2>(aState, aP2);
 			push<P3>(aState, aP3);
-			if(lua_pcall(aState, 4, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 4, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -411,7 +676,7 @@ namespace asmith { namespace Lua {
 			push<P2>(aState, aP2);
 			push<P3>(aState, aP3);
 			push<P4>(aState, aP4);
-			if(lua_pcall(aState, 5, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 5, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -425,7 +690,7 @@ namespace asmith { namespace Lua {
 			push<P3>(aState, aP3);
 			push<P4>(aState, aP4);
 			push<P5>(aState, aP5);
-			if(lua_pcall(aState, 6, 0, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 6, 0, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 		}
 	};
 
@@ -433,7 +698,7 @@ namespace asmith { namespace Lua {
 	struct LuaFunctionWrapper<R> {
 		static R call(lua_State* aState, String aName) {
 			lua_getglobal(aState, aName);
-			if(lua_pcall(aState, 0, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 0, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -445,7 +710,7 @@ namespace asmith { namespace Lua {
 		static R call(lua_State* aState, String aName, P0 aP0) {
 			lua_getglobal(aState, aName);
 			push<P0>(aState, aP0);
-			if(lua_pcall(aState, 1, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 1, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -458,7 +723,7 @@ namespace asmith { namespace Lua {
 			lua_getglobal(aState, aName);
 			push<P0>(aState, aP0);
 			push<P1>(aState, aP1);
-			if(lua_pcall(aState, 2, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 2, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -472,7 +737,7 @@ namespace asmith { namespace Lua {
 			push<P0>(aState, aP0);
 			push<P1>(aState, aP1);
 			push<P2>(aState, aP2);
-			if(lua_pcall(aState, 3, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 3, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -487,7 +752,7 @@ namespace asmith { namespace Lua {
 			push<P1>(aState, aP1);
 			push<P2>(aState, aP2);
 			push<P3>(aState, aP3);
-			if(lua_pcall(aState, 4, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 4, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -503,7 +768,7 @@ namespace asmith { namespace Lua {
 			push<P2>(aState, aP2);
 			push<P3>(aState, aP3);
 			push<P4>(aState, aP4);
-			if(lua_pcall(aState, 5, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 5, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
@@ -520,16 +785,125 @@ namespace asmith { namespace Lua {
 			push<P3>(aState, aP3);
 			push<P4>(aState, aP4);
 			push<P5>(aState, aP5);
-			if(lua_pcall(aState, 6, 1, 0) != 0) throw std::runtime_error(lua_tostring(aState, -1));
+			if(lua_pcall(aState, 6, 1, 0) != 0) ASMITH_LUA_THROW(lua_tostring(aState, -1));
 			R tmp = to<R>(aState, -1);
 			lua_pop(aState, 1);
 			return tmp;
 		}
 	};
 
+	// Batch Lua function call
+
+	template<size_t I, class...PARAMS>
+	struct TuplePusher {
+		static void push(lua_State* aState, const std::tuple<PARAMS...>& aParams) {
+			typedef typename std::tuple_element<I - 1, std::tuple<PARAMS...>>::type T;
+			TuplePusher<I - 1, PARAMS...>::push(aState, aParams);
+			implementation::push<T>(aState, std::get<I - 1>(aParams));
+		}
+	};
+
+	template<class...PARAMS>
+	struct TuplePusher<0, PARAMS...> {
+		static void push(lua_State*, const std::tuple<PARAMS...>&) {}
+	};
+
+	inline void batchError(lua_State* aState, int aTop) {
+		const std::string errorMsg = lua_type(aState, -1) == LUA_TSTRING ? lua_tostring(aState, -1) : "Unknown error";
+		lua_settop(aState, aTop);
+		ASMITH_LUA_THROW(errorMsg);
+	}
+
+	// Pushes the function and checks that the stack can hold a call
+	template<class...PARAMS>
+	inline int batchBegin(lua_State* aState, String aName) {
+		if(! lua_checkstack(aState, sizeof...(PARAMS) + 4)) ASMITH_LUA_THROW("asmith::Lua::State::callBatch : Lua stack overflow");
+		const int top = lua_gettop(aState);
+		lua_getglobal(aState, aName);
+		return top;
+	}
+
+	// Pushes an array of argument arrays, for functions that process a whole batch in one call
+	template<class...PARAMS>
+	inline void batchTable(lua_State* aState, const std::tuple<PARAMS...>* aParams, size_t aCount) {
+		const int size = static_cast<int>(sizeof...(PARAMS));
+		lua_createtable(aState, static_cast<int>(aCount), 0);
+		for(size_t i = 0; i < aCount; ++i) {
+			lua_createtable(aState, size, 0);
+			TuplePusher<sizeof...(PARAMS), PARAMS...>::push(aState, aParams[i]);
+			for(int j = size; j > 0; --j) lua_rawseti(aState, -(j + 1), j);
+			lua_rawseti(aState, -2, static_cast<lua_Integer>(i + 1));
+		}
+	}
+
+	template<class R, class...PARAMS>
+	struct LuaBatchWrapper {
+		// The strings would be popped before the caller could read them
+		static_assert(! std::is_same<R, String>::value, "asmith::Lua::State::callBatch : String results are not supported");
+
+		static void call(lua_State* aState, String aName, const std::tuple<PARAMS...>* aParams, R* aResults, size_t aCount) {
+			const int top = batchBegin<PARAMS...>(aState, aName);
+			const int function = top + 1;
+			for(size_t i = 0; i < aCount; ++i) {
+				lua_pushvalue(aState, function);
+				TuplePusher<sizeof...(PARAMS), PARAMS...>::push(aState, aParams[i]);
+				if(lua_pcall(aState, sizeof...(PARAMS), 1, 0) != 0) batchError(aState, top);
+				aResults[i] = to<R>(aState, -1);
+				lua_pop(aState, 1);
+			}
+			lua_settop(aState, top);
+		}
+
+		static void callTable(lua_State* aState, String aName, const std::tuple<PARAMS...>* aParams, R* aResults, size_t aCount) {
+			const int top = batchBegin<PARAMS...>(aState, aName);
+			batchTable<PARAMS...>(aState, aParams, aCount);
+			if(lua_pcall(aState, 1, 1, 0) != 0) batchError(aState, top);
+			if(! lua_istable(aState, -1)) {
+				lua_settop(aState, top);
+				ASMITH_LUA_THROW(std::string("asmith::Lua::State::callBatch : ") + aName + " did not return a table");
+			}
+			if(tableLength(aState, -1) != aCount) {
+				lua_settop(aState, top);
+				ASMITH_LUA_THROW(std::string("asmith::Lua::State::callBatch : ") + aName + " returned the wrong number of results");
+			}
+			for(size_t i = 0; i < aCount; ++i) {
+				lua_rawgeti(aState, -1, static_cast<lua_Integer>(i + 1));
+				aResults[i] = to<R>(aState, -1);
+				lua_pop(aState, 1);
+			}
+			lua_settop(aState, top);
+		}
+	};
+
+	template<class...PARAMS>
+	struct LuaBatchWrapper<void, PARAMS...> {
+		static void call(lua_State* aState, String aName, const std::tuple<PARAMS...>* aParams, size_t aCount) {
+			const int top = batchBegin<PARAMS...>(aState, aName);
+			const int function = top + 1;
+			for(size_t i = 0; i < aCount; ++i) {
+				lua_pushvalue(aState, function);
+				TuplePusher<sizeof...(PARAMS), PARAMS...>::push(aState, aParams[i]);
+				if(lua_pcall(aState, sizeof...(PARAMS), 0, 0) != 0) batchError(aState, top);
+			}
+			lua_settop(aState, top);
+		}
+
+		static void callTable(lua_State* aState, String aName, const std::tuple<PARAMS...>* aParams, size_t aCount) {
+			const int top = batchBegin<PARAMS...>(aState, aName);
+			batchTable<PARAMS...>(aState, aParams, aCount);
+			if(lua_pcall(aState, 1, 0, 0) != 0) batchError(aState, top);
+			lua_settop(aState, top);
+		}
+	};
+
 	}
 	// State class
 
+	enum BatchMode {
+		BATCH_CALL,		// One protected call per argument tuple
+		BATCH_TABLE		// A single call that receives an array of argument arrays and returns an array of results
+	};
+
 	class State {
 	private:
 		lua_State* const mState;
@@ -599,11 +973,102 @@ namespace asmith { namespace Lua {
 			lua_pushcfunction(mState, callback);
 		}
 
+		// Same as push, but for functions that only take and return booleans and numbers.
+		// Number parameters are checked like luaL_checknumber and boolean parameters only accept booleans.
+		// Built against LuaJIT the function is called through an FFI function pointer that compiled traces call directly,
+		// otherwise it is pushed as a C function. Either way it behaves the same when called from Lua.
+		// LuaJIT's FFI is loaded with require, so open the package library before pushing fast functions,
+		// functions pushed before that use the C wrapper.
+		template<class R, R(*FUN)()>
+		void pushFast() {
+			implementation::FastFunction<R>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, R(*FUN)(P0)>
+		void pushFast() {
+			implementation::FastFunction<R, P0>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, class P1, R(*FUN)(P0, P1)>
+		void pushFast() {
+			implementation::FastFunction<R, P0, P1>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, class P1, class P2, R(*FUN)(P0, P1, P2)>
+		void pushFast() {
+			implementation::FastFunction<R, P0, P1, P2>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, R(*FUN)(P0, P1, P2, P3)>
+		void pushFast() {
+			implementation::FastFunction<R, P0, P1, P2, P3>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, class P4, R(*FUN)(P0, P1, P2, P3, P4)>
+		void pushFast() {
+			implementation::FastFunction<R, P0, P1, P2, P3, P4>::template push<FUN>(mState, false);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, class P4, class P5, R(*FUN)(P0, P1, P2, P3, P4, P5)>
+		void pushFast() {
+			implementation::FastFunction<R, P0, P1, P2, P3, P4, P5>::template push<FUN>(mState, false);
+		}
+
+		// Pushes the array form of a fast function : f(xs, ys) calls FUN(xs[i], ys[i]) for every element and returns
+		// a table of the results. Scalar arguments are passed to every call, arrays must all have the same length.
+		template<class R, class P0, R(*FUN)(P0)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0>::template push<FUN>(mState, true);
+		}
+
+		template<class R, class P0, class P1, R(*FUN)(P0, P1)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0, P1>::template push<FUN>(mState, true);
+		}
+
+		template<class R, class P0, class P1, class P2, R(*FUN)(P0, P1, P2)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0, P1, P2>::template push<FUN>(mState, true);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, R(*FUN)(P0, P1, P2, P3)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0, P1, P2, P3>::template push<FUN>(mState, true);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, class P4, R(*FUN)(P0, P1, P2, P3, P4)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0, P1, P2, P3, P4>::template push<FUN>(mState, true);
+		}
+
+		template<class R, class P0, class P1, class P2, class P3, class P4, class P5, R(*FUN)(P0, P1, P2, P3, P4, P5)>
+		void pushFastArray() {
+			implementation::FastFunction<R, P0, P1, P2, P3, P4, P5>::template push<FUN>(mState, true);
+		}
+
 		template<class R, class...PARAMS>
 		R call(String aName, PARAMS... aParams) {
 			return implementation::LuaFunctionWrapper<R, PARAMS...>::call(mState, aName, aParams...);
 		}
 
+		template<class R, class...PARAMS>
+		void callBatch(String aName, const std::tuple<PARAMS...>* aParams, R* aResults, size_t aCount, BatchMode aMode = BATCH_CALL) {
+			if(aMode == BATCH_TABLE) {
+				implementation::LuaBatchWrapper<R, PARAMS...>::callTable(mState, aName, aParams, aResults, aCount);
+			} else {
+				implementation::LuaBatchWrapper<R, PARAMS...>::call(mState, aName, aParams, aResults, aCount);
+			}
+		}
+
+		template<class...PARAMS>
+		void callBatch(String aName, const std::tuple<PARAMS...>* aParams, size_t aCount, BatchMode aMode = BATCH_CALL) {
+			if(aMode == BATCH_TABLE) {
+				implementation::LuaBatchWrapper<void, PARAMS...>::callTable(mState, aName, aParams, aCount);
+			} else {
+				implementation::LuaBatchWrapper<void, PARAMS...>::call(mState, aName, aParams, aCount);
+			}
+		}
+
 		template<class R, class...PARAMS>
 		std::function<R(PARAMS...)> wrapFunction(String aName) {
 			const std::string name = aName;
@@ -620,4 +1085,8 @@ namespace asmith { namespace Lua {
 	};
 }}
 
+#ifdef ASMITH_LUA_HEADER_ONLY
+	#include "state.cpp"
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+// Measures the per-call overhead of functions bound with State::push against State::pushFast and State::pushFastArray
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "asmith/lua/state.hpp"
+#include "asmith/lua/script.hpp"
+
+using namespace asmith::Lua;
+
+static double add(double aX, double aY) {
+	return aX + aY;
+}
+
+static double run(State& aState, const char* aName, const std::string& aSource, int aCalls) {
+	Script script(aState);
+	script.load(aSource.c_str());
+	const auto begin = std::chrono::steady_clock::now();
+	script();
+	const auto end = std::chrono::steady_clock::now();
+	const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / aCalls;
+	printf("%-12s %8.2f ns/call\n", aName, ns);
+	return ns;
+}
+
+int main(int argc, char** argv) {
+	const int calls = argc > 1 ? atoi(argv[1]) : 10000000;
+	const std::string count = std::to_string(calls);
+
+	State state;
+	luaL_openlibs(state.getHandle());
+
+	state.push<double, double, double, add>();
+	state.setGlobal("add");
+	state.pushFast<double, double, double, add>();
+	state.setGlobal("fastAdd");
+	state.pushFastArray<double, double, double, add>();
+	state.setGlobal("fastAddAll");
+
+#ifdef LUAJIT_VERSION
+	printf("%s, %d calls\n", LUAJIT_VERSION, calls);
+#else
+	printf("%s, %d calls\n", LUA_VERSION, calls);
+#endif
+	run(state, "empty loop", "local x = 0 for i = 1, " + count + " do x = x + i end", calls);
+	run(state, "push", "local f, x = add, 0 for i = 1, " + count + " do x = f(x, i) end", calls);
+	run(state, "pushFast", "local f, x = fastAdd, 0 for i = 1, " + count + " do x = f(x, i) end", calls);
+
+	// Per element cost of adding two arrays, with a Lua loop around push and with the array form of pushFast
+	const std::string arrays = "local n = 1000 local xs, ys = {}, {} for i = 1, n do xs[i] = i ys[i] = i end ";
+	const std::string repeats = std::to_string(calls / 1000);
+	run(state, "push loop", arrays + "local f = add for i = 1, " + repeats + " do local r = {} for j = 1, n do r[j] = f(xs[j], ys[j]) end end", (calls / 1000) * 1000);
+	run(state, "array", arrays + "local f = fastAddAll for i = 1, " + repeats + " do f(xs, ys) end", (calls / 1000) * 1000);
+	return 0;
+}
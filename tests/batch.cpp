@@ -0,0 +1,74 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+
+using namespace asmith::Lua;
+
+static void testCall(State& aState) {
+	const std::tuple<Number, Number> params[] = {
+		std::make_tuple(1.0, 2.0),
+		std::make_tuple(3.0, 4.0),
+		std::make_tuple(5.0, 6.0)
+	};
+	Number results[3] = { 0.0, 0.0, 0.0 };
+
+	aState.callBatch("multiply", params, results, 3);
+	ASMITH_LUA_CHECK(results[0] == 2.0 && results[1] == 12.0 && results[2] == 30.0);
+
+	Number tableResults[3] = { 0.0, 0.0, 0.0 };
+	aState.callBatch("multiplyAll", params, tableResults, 3, BATCH_TABLE);
+	ASMITH_LUA_CHECK(tableResults[0] == 2.0 && tableResults[1] == 12.0 && tableResults[2] == 30.0);
+
+	aState.callBatch("accumulate", params, 3);
+	ASMITH_LUA_CHECK_LUA(aState, "total == 21 and calls == 3");
+	aState.callBatch("accumulateAll", params, 3, BATCH_TABLE);
+	ASMITH_LUA_CHECK_LUA(aState, "total == 42 and calls == 4");
+
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+static void testErrors(State& aState) {
+	const std::tuple<Number, Number> params[] = {
+		std::make_tuple(1.0, 2.0),
+		std::make_tuple(-1.0, 2.0),
+		std::make_tuple(3.0, 4.0)
+	};
+	Number results[3] = { 0.0, 0.0, 0.0 };
+
+	ASMITH_LUA_CHECK_THROWS(aState.callBatch("checked", params, results, 3));
+	ASMITH_LUA_CHECK(results[0] == 2.0);
+	ASMITH_LUA_CHECK_THROWS(aState.callBatch("short", params, results, 3, BATCH_TABLE));
+	ASMITH_LUA_CHECK_THROWS(aState.callBatch("notTable", params, results, 3, BATCH_TABLE));
+	ASMITH_LUA_CHECK_THROWS(aState.callBatch("missing", params, results, 3));
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+int main() {
+	State state;
+	test::openLibs(state);
+	test::run(state,
+		"function multiply(a, b) return a * b end "
+		"function multiplyAll(t) local r = {} for i, v in ipairs(t) do r[i] = v[1] * v[2] end return r end "
+		"total, calls = 0, 0 "
+		"function accumulate(a, b) total = total + a + b calls = calls + 1 end "
+		"function accumulateAll(t) for i, v in ipairs(t) do total = total + v[1] + v[2] end calls = calls + 1 end "
+		"function checked(a, b) if a < 0 then error('negative') end return a * b end "
+		"function short(t) return { 1 } end "
+		"function notTable(t) return 5 end"
+	);
+
+	testCall(state);
+	testErrors(state);
+	return ASMITH_LUA_TEST_RESULT();
+}
@@ -0,0 +1,151 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+
+#include <cstddef>
+#include "test.hpp"
+#include "asmith/lua/event.hpp"
+
+using namespace asmith::Lua;
+
+// Over aligned types are not supported by new before C++17
+static_assert(alignof(EventDispatcher) <= alignof(std::max_align_t), "EventDispatcher must not be over aligned");
+
+// post(id, value) from Lua, used to queue events while a batch is being delivered
+static int postFromLua(lua_State* aState) {
+	EventDispatcher& dispatcher = *static_cast<EventDispatcher*>(lua_touserdata(aState, lua_upvalueindex(1)));
+	lua_pushboolean(aState, dispatcher.post(static_cast<uint32_t>(luaL_checkinteger(aState, 1)), luaL_checknumber(aState, 2)));
+	return 1;
+}
+
+static void testQueue() {
+	EventQueue queue(3);
+	ASMITH_LUA_CHECK(queue.capacity() == 4);
+
+	Event event;
+	event.value = 0.0;
+	for(uint32_t i = 0; i < 4; ++i) {
+		event.id = i;
+		ASMITH_LUA_CHECK(queue.push(event));
+	}
+	ASMITH_LUA_CHECK(! queue.push(event));
+	ASMITH_LUA_CHECK(queue.size() == 4);
+
+	for(uint32_t i = 0; i < 4; ++i) ASMITH_LUA_CHECK(queue.pop(event) && event.id == i);
+	ASMITH_LUA_CHECK(! queue.pop(event));
+}
+
+static void testDispatch(State& aState) {
+	EventDispatcher dispatcher(aState);
+	test::run(aState,
+		"received = {} "
+		"setEventHandler(1, function(id, value) received[#received + 1] = value end) "
+		"setEventHandler(2, function(id, value) error('bad event ' .. value) end) "
+		"setEventHandler(3, function(id, value) received[#received + 1] = id * 100 + value end)"
+	);
+
+	ASMITH_LUA_CHECK(dispatcher.post(1, 10.0));
+	ASMITH_LUA_CHECK(dispatcher.post(2, 20.0));
+	ASMITH_LUA_CHECK(dispatcher.post(3, 30.0));
+	ASMITH_LUA_CHECK(dispatcher.post(4, 40.0));
+	ASMITH_LUA_CHECK(dispatcher.post(2, 50.0));
+	ASMITH_LUA_CHECK(dispatcher.post(1, 60.0));
+
+	// Errors in one handler do not stop later events, and events without a handler are dropped
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 6);
+	ASMITH_LUA_CHECK_LUA(aState, "#received == 3 and received[1] == 10 and received[2] == 330 and received[3] == 60");
+	ASMITH_LUA_CHECK(dispatcher.getErrorCount() == 2);
+	ASMITH_LUA_CHECK(dispatcher.getLastError().find("bad event 50") != std::string::npos);
+	dispatcher.clearErrors();
+	ASMITH_LUA_CHECK(dispatcher.getErrorCount() == 0 && dispatcher.getLastError().empty());
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 0);
+
+	dispatcher.removeHandler(1);
+	ASMITH_LUA_CHECK(dispatcher.post(1, 70.0));
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+	ASMITH_LUA_CHECK_LUA(aState, "#received == 3");
+
+	test::run(aState, "function fromGlobal(id, value) received[#received + 1] = -value end");
+	dispatcher.setHandler(1, "fromGlobal");
+	ASMITH_LUA_CHECK_THROWS(dispatcher.setHandler(1, "missing"));
+	ASMITH_LUA_CHECK(dispatcher.post(1, 80.0));
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+	ASMITH_LUA_CHECK_LUA(aState, "received[4] == -80");
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+static void testPostWhileDispatching(State& aState) {
+	EventDispatcher dispatcher(aState);
+	lua_State* const state = aState.getHandle();
+	lua_pushlightuserdata(state, &dispatcher);
+	lua_pushcclosure(state, postFromLua, 1);
+	lua_setglobal(state, "post");
+
+	test::run(aState,
+		"chain = {} "
+		"setEventHandler(5, function(id, value) chain[#chain + 1] = value if value < 3 then post(5, value + 1) end end)"
+	);
+
+	// Each event queues the next one, which must wait for the following dispatch
+	ASMITH_LUA_CHECK(dispatcher.post(5, 1.0));
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+	ASMITH_LUA_CHECK_LUA(aState, "#chain == 1");
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+	ASMITH_LUA_CHECK_LUA(aState, "#chain == 2");
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+	ASMITH_LUA_CHECK_LUA(aState, "#chain == 3 and chain[3] == 3");
+	ASMITH_LUA_CHECK(dispatcher.dispatch() == 0);
+}
+
+static void testLimits(State& aState) {
+	{
+		EventDispatcher dispatcher(aState, 2, "onEvent");
+		ASMITH_LUA_CHECK(dispatcher.post(0));
+		ASMITH_LUA_CHECK(dispatcher.post(0));
+		ASMITH_LUA_CHECK(! dispatcher.post(0));
+		ASMITH_LUA_CHECK(dispatcher.dispatch() == 2);
+
+		// IDs are stored at ID + 1 in the handler table and must fit in an int
+		ASMITH_LUA_CHECK(! dispatcher.post(EventDispatcher::MAX_ID + 1u));
+		ASMITH_LUA_CHECK(! dispatcher.post(UINT32_MAX));
+		ASMITH_LUA_CHECK_THROWS(dispatcher.setHandler(UINT32_MAX, "print"));
+		dispatcher.removeHandler(UINT32_MAX);
+		ASMITH_LUA_CHECK_THROWS(test::run(aState, "onEvent(4294967295, print)"));
+		ASMITH_LUA_CHECK_THROWS(test::run(aState, "onEvent(-1, print)"));
+
+		test::run(aState, "largest = nil onEvent(2147483646, function(id, value) largest = id end)");
+		ASMITH_LUA_CHECK(dispatcher.post(EventDispatcher::MAX_ID));
+		ASMITH_LUA_CHECK(dispatcher.dispatch() == 1);
+		ASMITH_LUA_CHECK_LUA(aState, "largest == 2147483646");
+	}
+
+	// The register function is removed with its dispatcher, unless the global has been replaced
+	ASMITH_LUA_CHECK_LUA(aState, "onEvent == nil");
+	{
+		EventDispatcher dispatcher(aState, 2, "onEvent");
+		test::run(aState, "onEvent = print");
+	}
+	ASMITH_LUA_CHECK_LUA(aState, "onEvent == print");
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+int main() {
+	State state;
+	test::openLibs(state);
+
+	testQueue();
+	testDispatch(state);
+	testPostWhileDispatching(state);
+	testLimits(state);
+	return ASMITH_LUA_TEST_RESULT();
+}
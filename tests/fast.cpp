@@ -0,0 +1,189 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+
+using namespace asmith::Lua;
+
+static double gTotal = 0.0;
+
+static double add(double aX, double aY) {
+	return aX + aY;
+}
+
+static void accumulate(double aValue) {
+	gTotal += aValue;
+}
+
+static bool positive(int32_t aValue) {
+	return aValue > 0;
+}
+
+static double digits(double aP0, double aP1, double aP2, double aP3, double aP4, double aP5) {
+	return aP0 * 100000.0 + aP1 * 10000.0 + aP2 * 1000.0 + aP3 * 100.0 + aP4 * 10.0 + aP5;
+}
+
+static int64_t negate(int64_t aValue) {
+	return -aValue;
+}
+
+// 64 bit integers cannot go through the FFI as plain numbers, so this always uses the C wrapper
+static int64_t addInteger(int64_t aX, int64_t aY) {
+	return aX + aY;
+}
+
+static bool notb(bool aValue) {
+	return ! aValue;
+}
+
+static void testScalar(State& aState) {
+	ASMITH_LUA_CHECK_LUA(aState, "add(1, 2) == 3");
+	ASMITH_LUA_CHECK_LUA(aState, "add(0.5, -2) == -1.5");
+	ASMITH_LUA_CHECK_LUA(aState, "positive(5) == true and positive(-5) == false");
+	ASMITH_LUA_CHECK_LUA(aState, "positive(1.5) == true and positive(-0.5) == false");
+	ASMITH_LUA_CHECK_LUA(aState, "negate(7) == -7");
+	ASMITH_LUA_CHECK_LUA(aState, "notb(true) == false and notb(false) == true");
+	ASMITH_LUA_CHECK_LUA(aState, "digits(1, 2, 3, 4, 5, 6) == 123456");
+	ASMITH_LUA_CHECK_LUA(aState, "slowDigits(1, 2, 3, 4, 5, 6) == 123456");
+
+	gTotal = 0.0;
+	test::run(aState, "accumulate(2) accumulate(3)");
+	ASMITH_LUA_CHECK(gTotal == 5.0);
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+// Every build must give the same results for the same calls, whether the function goes through the FFI or not
+static void testConversions(State& aState) {
+	ASMITH_LUA_CHECK_RAISES(aState, "add(nil, 2)", "number expected, got nil");
+	ASMITH_LUA_CHECK_RAISES(aState, "add('x', 2)", "number expected, got string");
+	ASMITH_LUA_CHECK_RAISES(aState, "add(1)", "bad argument #2");
+	ASMITH_LUA_CHECK_RAISES(aState, "add(1, true)", "number expected, got boolean");
+	ASMITH_LUA_CHECK_RAISES(aState, "addInteger(nil, 2)", "number expected, got nil");
+	ASMITH_LUA_CHECK_RAISES(aState, "addInteger('x', 2)", "number expected, got string");
+	ASMITH_LUA_CHECK_RAISES(aState, "addInteger(1)", "bad argument #2");
+	ASMITH_LUA_CHECK_RAISES(aState, "addInteger(1, true)", "number expected, got boolean");
+	ASMITH_LUA_CHECK_RAISES(aState, "notb(0)", "boolean expected, got number");
+	ASMITH_LUA_CHECK_RAISES(aState, "notb(nil)", "boolean expected, got nil");
+	ASMITH_LUA_CHECK_RAISES(aState, "negate('seven')", "number expected, got string");
+
+	// Numeric strings are converted in the same way as luaL_checknumber
+	ASMITH_LUA_CHECK_LUA(aState, "add('1', 2) == 3 and addInteger('1', '2') == 3 and negate(' 0x10 ') == -16");
+	ASMITH_LUA_CHECK_LUA(aState, "addAll({ '1', 2 }, '10')[1] == 11");
+	ASMITH_LUA_CHECK_RAISES(aState, "add({ 1 }, 2)", "number expected, got table");
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+static void testArray(State& aState) {
+	test::run(aState, "r = addAll({ 1, 2, 3 }, { 10, 20, 30 })");
+	ASMITH_LUA_CHECK_LUA(aState, "#r == 3 and r[1] == 11 and r[2] == 22 and r[3] == 33");
+
+	// Scalars are passed to every call, whichever position the table is in
+	test::run(aState, "r = addAll(1, { 10, 20 })");
+	ASMITH_LUA_CHECK_LUA(aState, "#r == 2 and r[1] == 11 and r[2] == 21");
+	test::run(aState, "r = addAll({ 10, 20 }, 1)");
+	ASMITH_LUA_CHECK_LUA(aState, "#r == 2 and r[1] == 11 and r[2] == 21");
+
+	test::run(aState, "r = positiveAll({ 1, -1 })");
+	ASMITH_LUA_CHECK_LUA(aState, "r[1] == true and r[2] == false");
+	test::run(aState, "r = notbAll({ true, false })");
+	ASMITH_LUA_CHECK_LUA(aState, "r[1] == false and r[2] == true");
+	test::run(aState, "r = negateAll({ 1, -2 })");
+	ASMITH_LUA_CHECK_LUA(aState, "r[1] == -1 and r[2] == 2");
+	test::run(aState, "r = digitsAll({ 1, 6 }, 2, 3, 4, 5, { 6, 1 })");
+	ASMITH_LUA_CHECK_LUA(aState, "r[1] == 123456 and r[2] == 623451");
+	test::run(aState, "r = addAll({}, {})");
+	ASMITH_LUA_CHECK_LUA(aState, "type(r) == 'table' and #r == 0");
+
+	gTotal = 0.0;
+	test::run(aState, "accumulateAll({ 1, 2, 3 })");
+	ASMITH_LUA_CHECK(gTotal == 6.0);
+
+	ASMITH_LUA_CHECK_RAISES(aState, "addAll({ 1, 2 }, { 1 })", "arrays must have the same length");
+	ASMITH_LUA_CHECK_RAISES(aState, "addAll(1, 2)", "array expected");
+	ASMITH_LUA_CHECK_RAISES(aState, "addAll({ 1, 'x' }, 1)", "number expected at index 2, got string");
+	ASMITH_LUA_CHECK_RAISES(aState, "addAll({ 1, 2 }, nil)", "number expected, got nil");
+	ASMITH_LUA_CHECK_RAISES(aState, "notbAll({ true, 0 })", "boolean expected at index 2, got number");
+	ASMITH_LUA_CHECK_RAISES(aState, "negateAll({ 1, false, 3 })", "number expected at index 2, got boolean");
+
+	// The scalar form does not accept arrays
+	ASMITH_LUA_CHECK_RAISES(aState, "accumulate({ 1 })", "number expected, got table");
+	ASMITH_LUA_CHECK(lua_gettop(aState.getHandle()) == 0);
+}
+
+// Functions pushed before the libraries are opened use the C wrapper, later ones must still get the FFI path
+static void testLateLibraries() {
+	State state;
+	state.pushFast<double, double, double, add>();
+	state.setGlobal("early");
+	test::openLibs(state);
+	state.pushFast<double, double, double, add>();
+	state.setGlobal("late");
+
+	ASMITH_LUA_CHECK_LUA(state, "early(1, 2) == 3 and late(1, 2) == 3");
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(early, 'S').what == 'C'");
+#ifdef LUAJIT_VERSION
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(late, 'S').what == 'Lua'");
+#else
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(late, 'S').what == 'C'");
+#endif
+}
+
+int main() {
+	State state;
+	test::openLibs(state);
+
+	state.pushFast<double, double, double, add>();
+	state.setGlobal("add");
+	state.pushFast<void, double, accumulate>();
+	state.setGlobal("accumulate");
+	state.pushFast<bool, int32_t, positive>();
+	state.setGlobal("positive");
+	state.pushFast<bool, bool, notb>();
+	state.setGlobal("notb");
+	state.pushFast<double, double, double, double, double, double, double, digits>();
+	state.setGlobal("digits");
+	state.pushFast<int64_t, int64_t, negate>();
+	state.setGlobal("negate");
+	state.pushFast<int64_t, int64_t, int64_t, addInteger>();
+	state.setGlobal("addInteger");
+	state.push<double, double, double, double, double, double, double, digits>();
+	state.setGlobal("slowDigits");
+
+	state.pushFastArray<double, double, double, add>();
+	state.setGlobal("addAll");
+	state.pushFastArray<void, double, accumulate>();
+	state.setGlobal("accumulateAll");
+	state.pushFastArray<bool, int32_t, positive>();
+	state.setGlobal("positiveAll");
+	state.pushFastArray<bool, bool, notb>();
+	state.setGlobal("notbAll");
+	state.pushFastArray<double, double, double, double, double, double, double, digits>();
+	state.setGlobal("digitsAll");
+	state.pushFastArray<int64_t, int64_t, negate>();
+	state.setGlobal("negateAll");
+
+#ifdef LUAJIT_VERSION
+	// Fast functions call an FFI pointer from a Lua wrapper instead of being C functions
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(add, 'S').what == 'Lua'");
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(addAll, 'S').what == 'Lua'");
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(addInteger, 'S').what == 'C'");
+#else
+	ASMITH_LUA_CHECK_LUA(state, "debug.getinfo(add, 'S').what == 'C'");
+#endif
+
+	testScalar(state);
+	testConversions(state);
+	testArray(state);
+	testLateLibraries();
+	return ASMITH_LUA_TEST_RESULT();
+}
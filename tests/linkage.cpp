@@ -0,0 +1,45 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+#include "asmith/lua/module.hpp"
+#include "asmith/lua/shared.hpp"
+
+using namespace asmith::Lua;
+
+void addFromOtherUnit();
+void installFromOtherUnit(State&);
+
+// Both translation units must share the same registries, searcher and statistics
+int main() {
+	ModuleCache::clear();
+	ModuleCache::resetStats();
+	addFromOtherUnit();
+	ASMITH_LUA_CHECK(ModuleCache::contains("other"));
+
+	State state;
+	test::openLibs(state);
+	ModuleCache::install(state);
+	test::run(state, "searchers = #(package.searchers or package.loaders)");
+	installFromOtherUnit(state);
+	ASMITH_LUA_CHECK_LUA(state, "#(package.searchers or package.loaders) == searchers");
+
+	ASMITH_LUA_CHECK_LUA(state, "require('other') == 'other'");
+	ASMITH_LUA_CHECK(ModuleCache::getStats().hits == 1);
+
+	SharedData::push(state, "otherNumbers");
+	state.setGlobal("view");
+	ASMITH_LUA_CHECK_LUA(state, "#view == 2 and view[2] == 5");
+	ASMITH_LUA_CHECK_LUA(state, "getmetatable(view) == getmetatable(otherNumbers)");
+	return ASMITH_LUA_TEST_RESULT();
+}
@@ -0,0 +1,33 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+#include "asmith/lua/module.hpp"
+#include "asmith/lua/shared.hpp"
+
+using namespace asmith::Lua;
+
+// Registers data from a second translation unit, a header only build links an inline copy of the library into each one
+
+static const Number gOtherNumbers[] = { 4.0, 5.0 };
+
+void addFromOtherUnit() {
+	const char* const source = "return 'other'";
+	ModuleCache::add("other", source, strlen(source));
+	SharedData::addArray<Number>("otherNumbers", gOtherNumbers, 2);
+}
+
+void installFromOtherUnit(State& aState) {
+	ModuleCache::install(aState);
+	SharedData::expose(aState);
+}
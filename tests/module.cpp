@@ -0,0 +1,142 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include <fstream>
+#include <iterator>
+#include "test.hpp"
+#include "asmith/lua/module.hpp"
+
+using namespace asmith::Lua;
+
+static void testCache() {
+	ModuleCache::clear();
+	ModuleCache::resetStats();
+	const char* const source = "return { value = 42 }";
+	ModuleCache::add("cached", source, strlen(source));
+	ASMITH_LUA_CHECK(ModuleCache::contains("cached"));
+	ASMITH_LUA_CHECK(! ModuleCache::contains("missing"));
+
+	const char* const invalid = "return {";
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::add("invalid", invalid, strlen(invalid)));
+	ASMITH_LUA_CHECK(! ModuleCache::contains("invalid"));
+
+	State state;
+	test::openLibs(state);
+	ModuleCache::install(state);
+	ModuleCache::install(state);
+
+	ASMITH_LUA_CHECK_LUA(state, "require('cached').value == 42");
+	ASMITH_LUA_CHECK_LUA(state, "not pcall(require, 'missing')");
+
+	const ModuleStats stats = ModuleCache::getStats();
+	ASMITH_LUA_CHECK(stats.hits == 1);
+	ASMITH_LUA_CHECK(stats.misses == 1);
+
+	// Preloaded modules take priority over the cache
+	test::run(state, "package.preload.cached = function() return { value = 7 } end package.loaded.cached = nil");
+	ASMITH_LUA_CHECK_LUA(state, "require('cached').value == 7");
+	ASMITH_LUA_CHECK(ModuleCache::getStats().hits == 1);
+
+	ASMITH_LUA_CHECK(lua_gettop(state.getHandle()) == 0);
+}
+
+static void testPrecompiled() {
+	State state;
+	test::openLibs(state);
+	lua_State* const handle = state.getHandle();
+	test::run(state, "chunk = string.dump(function() return 'precompiled' end)");
+	lua_getglobal(handle, "chunk");
+	size_t size = 0;
+	const char* const chunk = lua_tolstring(handle, -1, &size);
+	ModuleCache::add("precompiled", chunk, size);
+	lua_pop(handle, 1);
+
+	ModuleCache::install(state);
+	ASMITH_LUA_CHECK_LUA(state, "require('precompiled') == 'precompiled'");
+
+	// Precompiled chunks are checked to load before they are cached
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::add("corrupt", "\x1bgarbage", 8));
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::add("truncated", chunk, size / 2));
+	ASMITH_LUA_CHECK(! ModuleCache::contains("corrupt"));
+	ASMITH_LUA_CHECK(! ModuleCache::contains("truncated"));
+}
+
+static void testArchive(const std::string& aDirectory) {
+	const std::string path = aDirectory + "/modules.archive";
+	ModuleCache::saveArchive(path.c_str());
+	ModuleCache::clear();
+	ASMITH_LUA_CHECK(! ModuleCache::contains("cached"));
+
+	ModuleCache::loadArchive(path.c_str());
+	ASMITH_LUA_CHECK(ModuleCache::contains("cached"));
+	ASMITH_LUA_CHECK(ModuleCache::contains("precompiled"));
+
+	State state;
+	test::openLibs(state);
+	ModuleCache::install(state);
+	ASMITH_LUA_CHECK_LUA(state, "require('cached').value == 42 and require('precompiled') == 'precompiled'");
+
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::loadArchive((aDirectory + "/missing.archive").c_str()));
+	remove(path.c_str());
+}
+
+static void writeFile(const std::string& aPath, const std::string& aContents) {
+	std::ofstream file(aPath.c_str(), std::ios::binary);
+	file.write(aContents.data(), aContents.size());
+}
+
+// Archives from another Lua build, or without a header, are rejected before any module is added
+static void testArchiveHeader(const std::string& aDirectory) {
+	const std::string path = aDirectory + "/header.archive";
+	ModuleCache::saveArchive(path.c_str());
+	std::string archive;
+	{
+		std::ifstream file(path.c_str(), std::ios::binary);
+		archive.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	ModuleCache::clear();
+
+	// The header starts with 8 magic bytes followed by LUA_VERSION_NUM
+	std::string other = archive;
+	other[8] ^= 1;
+	writeFile(path, other);
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::loadArchive(path.c_str()));
+
+	// A different bytecode format changes the signature, which starts after the zero that ends the LuaJIT version
+	other = archive;
+	other[archive.find('\0', 12) + 2] ^= 1;
+	writeFile(path, other);
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::loadArchive(path.c_str()));
+
+	// A valid record in the format used before archives had a header
+	const char record[] = { 1, 0, 0, 0, 'm', 8, 0, 0, 0, 'r', 'e', 't', 'u', 'r', 'n', ' ', '1' };
+	writeFile(path, std::string(record, sizeof(record)));
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::loadArchive(path.c_str()));
+
+	writeFile(path, archive.substr(0, 10));
+	ASMITH_LUA_CHECK_THROWS(ModuleCache::loadArchive(path.c_str()));
+	ASMITH_LUA_CHECK(! ModuleCache::contains("cached") && ! ModuleCache::contains("m"));
+
+	writeFile(path, archive);
+	ModuleCache::loadArchive(path.c_str());
+	ASMITH_LUA_CHECK(ModuleCache::contains("cached"));
+	remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+	testCache();
+	testPrecompiled();
+	testArchive(argc > 1 ? argv[1] : ".");
+	testArchiveHeader(argc > 1 ? argv[1] : ".");
+	return ASMITH_LUA_TEST_RESULT();
+}
@@ -0,0 +1,117 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+#include "asmith/lua/serializer.hpp"
+
+using namespace asmith::Lua;
+
+static void roundTrip(State& aSource, State& aDestination, const char* aExpression) {
+	uint8_t buffer[4096];
+	lua_getglobal(aSource.getHandle(), aExpression);
+	Serializer::transfer(aSource, -1, aDestination, buffer, sizeof(buffer));
+	lua_pop(aSource.getHandle(), 1);
+	aDestination.setGlobal(aExpression);
+}
+
+static void testScalars() {
+	State source;
+	State destination;
+	test::openLibs(source);
+	test::openLibs(destination);
+	test::run(source, "b = true i = 42 n = 1.5 s = 'a\\0b'");
+
+	roundTrip(source, destination, "b");
+	roundTrip(source, destination, "i");
+	roundTrip(source, destination, "n");
+	roundTrip(source, destination, "s");
+	roundTrip(source, destination, "missing");
+
+	ASMITH_LUA_CHECK_LUA(destination, "b == true");
+	ASMITH_LUA_CHECK_LUA(destination, "i == 42");
+#if LUA_VERSION_NUM >= 503
+	ASMITH_LUA_CHECK_LUA(destination, "math.type(i) == 'integer'");
+	ASMITH_LUA_CHECK_LUA(destination, "math.type(n) == 'float'");
+#endif
+	ASMITH_LUA_CHECK_LUA(destination, "n == 1.5");
+	ASMITH_LUA_CHECK_LUA(destination, "s == 'a\\0b'");
+	ASMITH_LUA_CHECK_LUA(destination, "missing == nil");
+	ASMITH_LUA_CHECK(lua_gettop(source.getHandle()) == 0);
+	ASMITH_LUA_CHECK(lua_gettop(destination.getHandle()) == 0);
+}
+
+static void testTables() {
+	State source;
+	State destination;
+	test::openLibs(source);
+	test::openLibs(destination);
+	test::run(source,
+		"shared = { 1, 2, 3 } "
+		"t = { a = shared, b = shared, [shared] = 'key', nested = { deep = { 'x' } } } "
+		"t.self = t"
+	);
+
+	roundTrip(source, destination, "t");
+
+	ASMITH_LUA_CHECK_LUA(destination, "t.a == t.b");
+	ASMITH_LUA_CHECK_LUA(destination, "#t.a == 3 and t.a[3] == 3");
+	ASMITH_LUA_CHECK_LUA(destination, "t[t.a] == 'key'");
+	ASMITH_LUA_CHECK_LUA(destination, "t.self == t");
+	ASMITH_LUA_CHECK_LUA(destination, "t.nested.deep[1] == 'x'");
+	ASMITH_LUA_CHECK(lua_gettop(destination.getHandle()) == 0);
+}
+
+static void testErrors() {
+	State state;
+	test::openLibs(state);
+	lua_State* const handle = state.getHandle();
+	Serializer serializer(state);
+	uint8_t buffer[256];
+
+	// Buffer too small
+	test::run(state, "t = { 'a long string value', 'another long string value' }");
+	lua_getglobal(handle, "t");
+	ASMITH_LUA_CHECK_THROWS(serializer.serialize(-1, buffer, 8));
+	ASMITH_LUA_CHECK(lua_gettop(handle) == 1);
+
+	// Every truncation of a valid buffer is rejected
+	const size_t size = serializer.serialize(-1, buffer, sizeof(buffer));
+	lua_pop(handle, 1);
+	for(size_t i = 0; i < size; ++i) {
+		ASMITH_LUA_CHECK_THROWS(serializer.deserialize(buffer, i));
+		ASMITH_LUA_CHECK(lua_gettop(handle) == 0);
+	}
+
+	// Unsupported types
+	lua_getglobal(handle, "print");
+	ASMITH_LUA_CHECK_THROWS(serializer.serialize(-1, buffer, sizeof(buffer)));
+	lua_pop(handle, 1);
+
+	// Invalid tags and references
+	const uint8_t badTag[] = { 0xFF };
+	ASMITH_LUA_CHECK_THROWS(serializer.deserialize(badTag, sizeof(badTag)));
+	const uint8_t badReference[] = { Serializer::TAG_REFERENCE, 1, 0, 0, 0 };
+	ASMITH_LUA_CHECK_THROWS(serializer.deserialize(badReference, sizeof(badReference)));
+	const uint8_t forwardReference[] = { Serializer::TAG_TABLE, Serializer::TAG_TRUE, Serializer::TAG_REFERENCE, 2, 0, 0, 0, Serializer::TAG_TABLE_END };
+	ASMITH_LUA_CHECK_THROWS(serializer.deserialize(forwardReference, sizeof(forwardReference)));
+	const uint8_t nilKey[] = { Serializer::TAG_TABLE, Serializer::TAG_NIL, Serializer::TAG_TRUE, Serializer::TAG_TABLE_END };
+	ASMITH_LUA_CHECK_THROWS(serializer.deserialize(nilKey, sizeof(nilKey)));
+	ASMITH_LUA_CHECK(lua_gettop(handle) == 0);
+}
+
+int main() {
+	testScalars();
+	testTables();
+	testErrors();
+	return ASMITH_LUA_TEST_RESULT();
+}
@@ -0,0 +1,79 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#include "test.hpp"
+#include "asmith/lua/shared.hpp"
+
+using namespace asmith::Lua;
+
+static const Number gNumbers[] = { 1.5, 2.5, 3.5 };
+static std::map<std::string, String> gNames;
+static std::map<std::string, Number> gKeys;
+
+static void testViews(State& aState) {
+	ASMITH_LUA_CHECK_LUA(aState, "#numbers == 3");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[1] == 1.5 and numbers[3] == 3.5");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[0] == nil and numbers[4] == nil");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[-1] == nil and numbers[1.5] == nil");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[0/0] == nil and numbers[1/0] == nil and numbers[-1/0] == nil");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[2^70] == nil and numbers[-2^70] == nil");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers['1'] == nil and numbers.x == nil");
+
+	ASMITH_LUA_CHECK_LUA(aState, "#names == 2");
+	ASMITH_LUA_CHECK_LUA(aState, "names.alpha == 'a' and names.beta == 'b'");
+	ASMITH_LUA_CHECK_LUA(aState, "names.gamma == nil and names[1] == nil");
+
+	// Keys that are prefixes of each other, contain zeros or use bytes above 127 must still be found by the sorted lookup
+	ASMITH_LUA_CHECK_LUA(aState, "#keys == 6");
+	ASMITH_LUA_CHECK_LUA(aState, "keys[''] == 1 and keys.a == 2 and keys.ab == 3 and keys['a\\0b'] == 4");
+	ASMITH_LUA_CHECK_LUA(aState, "keys['\\128'] == 5 and keys.b == 6");
+	ASMITH_LUA_CHECK_LUA(aState, "keys['a\\0'] == nil and keys.abc == nil and keys['\\0'] == nil and keys.c == nil");
+
+	ASMITH_LUA_CHECK_LUA(aState, "not pcall(function() numbers[1] = 5 end)");
+	ASMITH_LUA_CHECK_LUA(aState, "not pcall(function() names.alpha = 'x' end)");
+	ASMITH_LUA_CHECK_LUA(aState, "not pcall(setmetatable, numbers, {})");
+	ASMITH_LUA_CHECK_LUA(aState, "numbers[1] == 1.5 and names.alpha == 'a'");
+}
+
+int main() {
+	gNames["alpha"] = "a";
+	gNames["beta"] = "b";
+	SharedData::addArray<Number>("numbers", gNumbers, 3);
+	SharedData::addMap<String>("names", gNames);
+	gKeys[""] = 1.0;
+	gKeys["a"] = 2.0;
+	gKeys["ab"] = 3.0;
+	gKeys[std::string("a\0b", 3)] = 4.0;
+	gKeys["\200"] = 5.0;
+	gKeys["b"] = 6.0;
+	SharedData::addMap<Number>("keys", gKeys);
+	ASMITH_LUA_CHECK_THROWS(SharedData::addArray<Number>("numbers", gNumbers, 3));
+
+	// Every state sees the same registered data
+	State first;
+	State second;
+	test::openLibs(first);
+	test::openLibs(second);
+	SharedData::expose(first);
+	SharedData::expose(second);
+	testViews(first);
+	testViews(second);
+
+	SharedData::push(first, "numbers");
+	first.setGlobal("view");
+	ASMITH_LUA_CHECK_LUA(first, "view[2] == 2.5");
+	ASMITH_LUA_CHECK_THROWS(SharedData::push(first, "missing"));
+	ASMITH_LUA_CHECK(lua_gettop(first.getHandle()) == 0);
+
+	return ASMITH_LUA_TEST_RESULT();
+}
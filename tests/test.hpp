@@ -0,0 +1,94 @@
+//	Copyright 2017 Adam Smith
+//	Licensed under the Apache License, Version 2.0 (the "License");
+//	you may not use this file except in compliance with the License.
+//	You may obtain a copy of the License at
+// 
+//	http://www.apache.org/licenses/LICENSE-2.0
+//
+//	Unless required by applicable law or agreed to in writing, software
+//	distributed under the License is distributed on an "AS IS" BASIS,
+//	WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//	See the License for the specific language governing permissions and
+//	limitations under the License.
+
+#ifndef ASMITH_LUA_TEST_HPP
+#define ASMITH_LUA_TEST_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "asmith/lua/state.hpp"
+
+namespace asmith { namespace Lua { namespace test {
+
+	inline int& failures() {
+		static int count = 0;
+		return count;
+	}
+
+	inline void fail(const char* aFile, int aLine, const char* aMessage) {
+		fprintf(stderr, "%s:%d: %s\n", aFile, aLine, aMessage);
+		++failures();
+	}
+
+	// Opens the standard libraries, tests use them to build values from Lua source
+	inline void openLibs(State& aState) {
+		luaL_openlibs(aState.getHandle());
+	}
+
+	// Runs a chunk, throwing with the Lua error message if it fails
+	inline void run(State& aState, const char* aSource) {
+		lua_State* const state = aState.getHandle();
+		if(luaL_loadbuffer(state, aSource, strlen(aSource), "=test") != 0 || lua_pcall(state, 0, 0, 0) != 0) {
+			const std::string errorMsg = lua_tostring(state, -1);
+			lua_pop(state, 1);
+			throw std::runtime_error(errorMsg);
+		}
+	}
+
+	// Evaluates a Lua expression and returns its truth value
+	inline bool eval(State& aState, const char* aExpression) {
+		lua_State* const state = aState.getHandle();
+		const std::string source = std::string("return ") + aExpression;
+		if(luaL_loadbuffer(state, source.c_str(), source.size(), "=test") != 0 || lua_pcall(state, 0, 1, 0) != 0) {
+			fprintf(stderr, "%s\n", lua_tostring(state, -1));
+			lua_pop(state, 1);
+			return false;
+		}
+		const bool result = lua_toboolean(state, -1) != 0;
+		lua_pop(state, 1);
+		return result;
+	}
+
+	// Runs a chunk and returns true if it raises an error whose message contains aMessage
+	inline bool raises(State& aState, const char* aSource, const char* aMessage) {
+		lua_State* const state = aState.getHandle();
+		if(luaL_loadbuffer(state, aSource, strlen(aSource), "=test") == 0 && lua_pcall(state, 0, 0, 0) == 0) return false;
+		const char* const errorMsg = lua_tostring(state, -1);
+		const bool result = errorMsg && strstr(errorMsg, aMessage);
+		if(! result) fprintf(stderr, "%s\n", errorMsg ? errorMsg : "(no message)");
+		lua_pop(state, 1);
+		return result;
+	}
+}}}
+
+#define ASMITH_LUA_CHECK(aCondition)\
+	do { if(! (aCondition)) asmith::Lua::test::fail(__FILE__, __LINE__, "Check failed : " #aCondition); } while(false)
+
+#define ASMITH_LUA_CHECK_LUA(aState, aExpression)\
+	do { if(! asmith::Lua::test::eval(aState, aExpression)) asmith::Lua::test::fail(__FILE__, __LINE__, "Lua check failed : " aExpression); } while(false)
+
+#define ASMITH_LUA_CHECK_RAISES(aState, aSource, aMessage)\
+	do { if(! asmith::Lua::test::raises(aState, aSource, aMessage)) asmith::Lua::test::fail(__FILE__, __LINE__, "Expected Lua error : " aSource); } while(false)
+
+#define ASMITH_LUA_CHECK_THROWS(aStatement)\
+	do {\
+		bool thrown = false;\
+		try { aStatement; } catch(std::exception&) { thrown = true; }\
+		if(! thrown) asmith::Lua::test::fail(__FILE__, __LINE__, "Expected exception : " #aStatement);\
+	} while(false)
+
+#define ASMITH_LUA_TEST_RESULT() (asmith::Lua::test::failures() == 0 ? 0 : 1)
+
+#endif